@@ -0,0 +1,305 @@
+// microbenchmarks for the OLED driver, draw_oled and the speed maths.
+//
+// built as spedo_bench in both builds: on the host it runs against the simulated SDK and times with
+// the PC's clock, on the pico it waits for a USB serial connection and times with the 1MHz timer,
+// also giving cycles at the current clk_sys. output is csv so runs can be diffed:
+//   name,iterations,ns_per_iter,cycles_per_iter,bytes_per_iter
+// bytes are what goes over i2c for each frame (not counting address bytes), blank where not relevant.
+// on the host the show timings include the simulator's OLED model, so only compare them with each other.
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+
+#include "display.h"
+#include "sprite.h"
+#include "sprites.h"
+#include "speed.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/clocks.h"
+#include "pico/stdio_usb.h"
+#define BENCH_MIN_NS 50000000ull
+#else
+#include <time.h>
+#include "sim.h"
+#define BENCH_MIN_NS 20000000ull
+#endif
+
+static ssd1306_t disp;
+
+static volatile uint32_t sink; // results go here so the compiler can't throw the work away
+static volatile uint32_t interval_base = 250000; // inputs come from here so they can't be folded into constants
+
+static uint64_t excluded_ns; // time spent in bench_exclude_begin/end, taken off the total
+static uint64_t exclude_start;
+static uint64_t total_bytes;
+
+static uint64_t now_ns(void) {
+#if PICO_ON_DEVICE
+    return time_us_64() * 1000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+// for setup inside an iteration that shouldn't be counted
+static void bench_exclude_begin(void) {
+    exclude_start = now_ns();
+}
+
+static void bench_exclude_end(void) {
+    excluded_ns += now_ns() - exclude_start;
+}
+
+static void wait_for_oled(void) {
+    bench_exclude_begin();
+    while (ssd1306_is_busy(&disp)) {
+        tight_loop_contents();
+    }
+    bench_exclude_end();
+}
+
+// run fn often enough to spend at least BENCH_MIN_NS in it and print a line for it
+static void run(const char *name, void (*fn)(uint32_t i)) {
+    uint32_t iters = 1;
+    uint64_t elapsed;
+    while (1) {
+        excluded_ns = 0;
+        total_bytes = 0;
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < iters; i++) {
+            fn(i);
+        }
+        elapsed = now_ns() - start - excluded_ns;
+        // waiting on the bus is excluded but still takes real time, so give up on those eventually
+        if (elapsed >= BENCH_MIN_NS || now_ns() - start >= 10 * BENCH_MIN_NS || iters >= (1u << 24)) {
+            break;
+        }
+        iters *= 2;
+    }
+
+    double ns = (double)elapsed / iters;
+    printf("%s,%lu,%.1f,", name, (unsigned long)iters, ns);
+#if PICO_ON_DEVICE
+    printf("%.0f", ns * clock_get_hz(clk_sys) / 1e9);
+#endif
+    printf(",");
+    if (total_bytes) {
+        printf("%lu", (unsigned long)(total_bytes / iters));
+    }
+    printf("\n");
+}
+
+// DRAWING ----------------------------------------------------------------------------
+
+static void bench_clear(uint32_t i) {
+    (void)i;
+    ssd1306_clear(&disp);
+}
+
+static void bench_string_1x(uint32_t i) {
+    (void)i;
+    ssd1306_draw_string(&disp, 50, 30, 1, "km/h avg.");
+}
+
+static void bench_string_2x(uint32_t i) {
+    (void)i;
+    ssd1306_draw_string(&disp, 0, 50, 2, "km/h");
+}
+
+// the same text, copied in from the pre-rendered glyph atlases instead
+static void bench_text_1x(uint32_t i) {
+    (void)i;
+    draw_text(&disp, 50, 3, &glyph_atlas_1x, "km/h avg.");
+}
+
+static void bench_text_2x(uint32_t i) {
+    (void)i;
+    draw_text(&disp, 0, 6, &glyph_atlas_2x, "km/h");
+}
+
+static void bench_text_digits(uint32_t i) {
+    (void)i;
+    draw_text(&disp, 71, 5, &glyph_atlas_digits, "16");
+}
+
+// the splash screen (run length encoded) and a frame of the wheel (masked)
+static void bench_sprite_splash(uint32_t i) {
+    (void)i;
+    sprite_draw(&disp, &sprite_splash, 0, 0, 0);
+}
+
+static void bench_sprite_wheel(uint32_t i) {
+    sprite_draw(&disp, &sprite_wheel, i % sprite_wheel.frames, 76, 5);
+}
+
+static void bench_line_shallow(uint32_t i) {
+    (void)i;
+    ssd1306_draw_line(&disp, 0, 0, 127, 63);
+}
+
+static void bench_line_steep(uint32_t i) {
+    (void)i;
+    ssd1306_draw_line(&disp, 10, 0, 20, 63);
+}
+
+static void bench_line_horizontal(uint32_t i) {
+    (void)i;
+    ssd1306_draw_line(&disp, 0, 33, 127, 33);
+}
+
+static void bench_square(uint32_t i) {
+    (void)i;
+    ssd1306_draw_square(&disp, 13, 5, 30, 20);
+}
+
+static ride_snapshot_t snapshot(uint32_t i) {
+    ride_snapshot_t snap = {
+        .dist = 12345 + (i & 1) * 2,
+        .mins_all = 63,
+        .mins_moving = 51,
+        .av_speed = 24,
+        .max_speed = 47,
+        .curr_speed_miles = 15 + (i & 1),
+    };
+    return snap;
+}
+
+// everything draw_oled does on a typical update: redraw what changed (the distance and speed) and start sending it
+static void bench_draw_oled(uint32_t i) {
+    wait_for_oled();
+    ride_snapshot_t snap = snapshot(i);
+    draw_oled(&disp, &snap);
+    total_bytes += disp.txlen;
+}
+
+// the same but from scratch, labels and all, with nothing on the OLED yet so every page goes out
+static void bench_draw_oled_full(uint32_t i) {
+    wait_for_oled();
+    ssd1306_invalidate(&disp);
+    draw_oled_invalidate();
+    ride_snapshot_t snap = snapshot(i);
+    draw_oled(&disp, &snap);
+    total_bytes += disp.txlen;
+}
+
+// SENDING ----------------------------------------------------------------------------
+// these time building the i2c stream and starting the DMA, not the wait for the bus (which is just
+// bytes_per_iter * 9 bits at the i2c baudrate)
+
+static void bench_show_full(uint32_t i) {
+    (void)i;
+    wait_for_oled();
+    ssd1306_invalidate(&disp);
+    ssd1306_show_async(&disp);
+    total_bytes += disp.txlen;
+}
+
+static void bench_show_digit(uint32_t i) {
+    wait_for_oled();
+    bench_exclude_begin();
+    ssd1306_clear(&disp);
+    ssd1306_draw_string(&disp, 80, 57, 1, i & 1 ? "15" : "16");
+    bench_exclude_end();
+    ssd1306_show_async(&disp);
+    total_bytes += disp.txlen;
+}
+
+// bringing the OLED up, which only queues the configuration to go out with the first frame
+static void bench_init(uint32_t i) {
+    (void)i;
+    ssd1306_t oled = {.external_vcc = false};
+    ssd1306_init(&oled, 128, 64, 0x3C, DISPLAY_I2C);
+    ssd1306_deinit(&oled);
+}
+
+static void bench_show_unchanged(uint32_t i) {
+    (void)i;
+    wait_for_oled();
+    ssd1306_show_async(&disp);
+    total_bytes += disp.txlen;
+}
+
+// SPEED MATHS ------------------------------------------------------------------------
+
+static void bench_speed_fixed(uint32_t i) {
+    sink = speed_kmh(speed_from_interval_us(interval_base + i));
+}
+
+// how it was done before speed.h
+static void bench_speed_float(uint32_t i) {
+    sink = (int)((WHEEL_CIRCUMFERENCE*60*60*1000) / (interval_base + i));
+}
+
+static void bench_mph_fixed(uint32_t i) {
+    sink = speed_kmh(speed_to_mph((interval_base + i) << 4));
+}
+
+static void bench_mph_float(uint32_t i) {
+    sink = (int)((int)(interval_base + i) * 0.62);
+}
+
+static void bench_average_fixed(uint32_t i) {
+    sink = speed_kmh(speed_average((interval_base + i) * 100, 3600 + (i & 0xFF)));
+}
+
+static void bench_average_float(uint32_t i) {
+    float dist = (interval_base + i) / 10.0f;
+    sink = (int)(3.6*(dist / (3600 + (i & 0xFF))));
+}
+
+int main(void) {
+#if PICO_ON_DEVICE
+    stdio_init_all();
+    while (!stdio_usb_connected()) {
+        sleep_ms(100);
+    }
+#else
+    sim_start();
+#endif
+
+    display_init_oled(&disp);
+    ssd1306_clear(&disp);
+    ssd1306_show(&disp);
+
+    printf("name,iterations,ns_per_iter,cycles_per_iter,bytes_per_iter\n");
+
+    run("ssd1306_clear", bench_clear);
+    run("ssd1306_draw_string_1x", bench_string_1x);
+    run("ssd1306_draw_string_2x", bench_string_2x);
+    run("draw_text_1x", bench_text_1x);
+    run("draw_text_2x", bench_text_2x);
+    run("draw_text_digits", bench_text_digits);
+    run("sprite_draw_splash", bench_sprite_splash);
+    run("sprite_draw_wheel", bench_sprite_wheel);
+    run("ssd1306_draw_line_shallow", bench_line_shallow);
+    run("ssd1306_draw_line_steep", bench_line_steep);
+    run("ssd1306_draw_line_horizontal", bench_line_horizontal);
+    run("ssd1306_draw_square", bench_square);
+    draw_oled_invalidate(); // the benchmarks before have drawn all over the buffer
+    run("draw_oled", bench_draw_oled);
+    run("draw_oled_full", bench_draw_oled_full);
+    wait_for_oled();
+
+    run("ssd1306_show_full", bench_show_full);
+    run("ssd1306_show_digit", bench_show_digit);
+    run("ssd1306_show_unchanged", bench_show_unchanged);
+    run("ssd1306_init", bench_init);
+    wait_for_oled();
+
+    run("speed_from_interval_fixed", bench_speed_fixed);
+    run("speed_from_interval_float", bench_speed_float);
+    run("speed_to_mph_fixed", bench_mph_fixed);
+    run("speed_to_mph_float", bench_mph_float);
+    run("speed_average_fixed", bench_average_fixed);
+    run("speed_average_float", bench_average_float);
+
+#if PICO_ON_DEVICE
+    while (1) {
+        tight_loop_contents();
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,327 @@
+#include <stddef.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/sync.h"
+
+#include "extern/pico-ssd1306/src/ssd1306.h"
+
+#include "display.h"
+#include "instr.h"
+#include "sprite.h"
+#include "sprites.h" // generated at build time from images/, see tools/sprites.py
+
+#if OLED_ON_CORE1
+#include "pico/multicore.h"
+#include "pico/flash.h"
+#endif
+
+uint32_t draw_text(ssd1306_t *disp, uint32_t x, uint32_t page, const glyph_atlas_t *atlas, const char *s) {
+    uint32_t glyph_bytes = atlas->width * atlas->pages;
+    for (; *s; s++, x += atlas->advance) {
+        uint8_t i = (uint8_t)*s - atlas->first;
+        if (i < atlas->count) {
+            ssd1306_blit_pages(disp, x, page, atlas->data + i * glyph_bytes, atlas->width, atlas->pages);
+        }
+    }
+    return x;
+}
+
+// the digits of n, written backwards from the end of buf (which needs to fit them), returns where they start.
+// a divide by a constant 10 is a multiply, so this is a lot lighter than sprintf
+static char *format_uint(char *end, uint32_t n) {
+    *--end = '\0';
+    do {
+        *--end = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    return end;
+}
+
+// SCREEN ----------------------------------------------------------------------------
+// the screen is a fixed layout of labels, drawn once, and numbers that are only redrawn when they change.
+// everything is on page boundaries, so all of it is copied straight in from the glyph atlases, and only
+// the pages that were actually touched go out to the OLED
+
+typedef struct {
+    uint8_t x;
+    uint8_t page;
+    const glyph_atlas_t *atlas;
+    const char *text;
+} label_t;
+
+// a number out of the snapshot, in a box that is cleared before it is redrawn
+typedef struct {
+    size_t field;  // offsetof the int in ride_snapshot_t
+    uint8_t x;     // left edge of the box
+    uint8_t page;  // top of the box
+    uint8_t width; // the box is as tall as the atlas
+    bool right;    // right aligned in the box, rather than left
+    int max;       // anything more is shown as this
+    const glyph_atlas_t *atlas;
+} widget_t;
+
+static const label_t labels[] = {
+    {50, 0, &glyph_atlas_1x, "metres"},
+    {50, 1, &glyph_atlas_1x, "minutes,"},
+    {50, 2, &glyph_atlas_1x, "moving"},
+    {50, 3, &glyph_atlas_1x, "km/h avg."},
+    {50, 4, &glyph_atlas_1x, "km/h max."},
+    {0, 6, &glyph_atlas_2x, "km/h"},
+    {107, 7, &glyph_atlas_1x, "mph"},
+    {26, 5, &glyph_atlas_1x, "rpm"},
+};
+
+static const widget_t widgets[] = {
+    {offsetof(ride_snapshot_t, dist), 0, 0, 48, false, 999999, &glyph_atlas_1x},
+    {offsetof(ride_snapshot_t, mins_all), 0, 1, 48, false, 999999, &glyph_atlas_1x},
+    {offsetof(ride_snapshot_t, mins_moving), 0, 2, 48, false, 999999, &glyph_atlas_1x},
+    {offsetof(ride_snapshot_t, av_speed), 0, 3, 48, false, 999999, &glyph_atlas_1x},
+    {offsetof(ride_snapshot_t, max_speed), 0, 4, 48, false, 999999, &glyph_atlas_1x},
+    // the current speed in big digits, up against "mph" (2 digits is plenty on a bike)
+    {offsetof(ride_snapshot_t, curr_speed_miles), 71, 5, 34, true, 99, &glyph_atlas_digits},
+    // cadence, in the gap above "km/h"
+    {offsetof(ride_snapshot_t, cadence), 0, 5, 24, false, 999, &glyph_atlas_1x},
+};
+
+#define WIDGETS (sizeof(widgets) / sizeof(widgets[0]))
+#define SPEED_WIDGET 5 // the one the wheel animation takes the place of
+
+static bool redraw_all = true; // the buffer doesn't have the screen in it, so start again from a blank one
+static int shown[WIDGETS];     // what each widget has in the buffer
+
+void draw_oled_invalidate(void) {
+    redraw_all = true;
+}
+
+static void draw_widget(ssd1306_t *disp, const widget_t *w, int value) {
+    char buf[12];
+    const char *text = format_uint(buf + sizeof(buf), value > 0 ? (uint32_t)value : 0);
+    uint32_t x = w->x;
+    if (w->right) {
+        uint32_t len = buf + sizeof(buf) - 1 - text;
+        x += w->width - (len * w->atlas->advance - (w->atlas->advance - w->atlas->width));
+    }
+    ssd1306_clear_pages(disp, w->x, w->page, w->width, w->atlas->pages);
+    draw_text(disp, x, w->page, w->atlas, text);
+}
+
+bool draw_oled(ssd1306_t *disp, const ride_snapshot_t *snap) {
+    if (redraw_all) {
+        ssd1306_clear(disp);
+        for (uint i = 0; i < sizeof(labels) / sizeof(labels[0]); i++) {
+            draw_text(disp, labels[i].x, labels[i].page, labels[i].atlas, labels[i].text);
+        }
+    }
+    for (uint i = 0; i < WIDGETS; i++) {
+        const widget_t *w = &widgets[i];
+        if (i == SPEED_WIDGET && snap->wheel_frame) {
+            // spinning wheel instead, and the speed is drawn again once it's done
+            ssd1306_clear_pages(disp, w->x, w->page, w->width, w->atlas->pages);
+            sprite_draw(disp, &sprite_wheel, (snap->wheel_frame - 1) % sprite_wheel.frames, w->x + (w->width - sprite_wheel.width) / 2, w->page);
+            shown[i] = -1;
+            continue;
+        }
+        int value = *(const int *)((const char *)snap + w->field);
+        if (value > w->max) {
+            value = w->max;
+        }
+        if (redraw_all || value != shown[i]) {
+            draw_widget(disp, w, value);
+            shown[i] = value;
+        }
+    }
+    redraw_all = false;
+    return ssd1306_show_async(disp);
+}
+
+// the splash screen, shown from power on until there is something to show
+static void draw_splash(ssd1306_t *disp) {
+    ssd1306_clear(disp);
+    sprite_draw(disp, &sprite_splash, 0, 0, 0);
+    draw_oled_invalidate();
+}
+
+// INSTRUMENTATION -------------------------------------------------------------------
+// by whichever core owns the OLED
+
+#if SPEDO_INSTR
+static uint64_t frame_edge_us = 0;  // the reed switch edge the buffer is showing, until it goes out (0 for none)
+static uint64_t bus_start_us = 0;   // when the frame on the bus started going out (0 for none)
+static uint32_t aborts_counted = 0; // of disp->aborts
+
+// a frame was just handed to ssd1306_show_async, which returned sent
+static void instr_frame(ssd1306_t *disp, bool sent) {
+    INSTR_COUNT(INSTR_I2C_ABORTS, disp->aborts - aborts_counted);
+    aborts_counted = disp->aborts;
+    if (!sent) {
+        INSTR_COUNT(INSTR_OLED_BUSY, 1);
+        return;
+    }
+    if (!disp->txlen) {
+        return; // nothing had changed
+    }
+    uint64_t now = time_us_64();
+    bus_start_us = now;
+    if (frame_edge_us) {
+        INSTR_RECORD(INSTR_EDGE_TO_OLED, now - frame_edge_us);
+        frame_edge_us = 0;
+    }
+}
+
+// the bus has been seen to be idle, so whatever frame was going out has gone
+static void instr_bus_idle(void) {
+    if (bus_start_us) {
+        INSTR_RECORD(INSTR_OLED_BUS, time_us_64() - bus_start_us);
+        bus_start_us = 0;
+    }
+}
+
+// draw_oled, timed
+static bool draw_oled_timed(ssd1306_t *disp, const ride_snapshot_t *snap) {
+    if (snap->edge_us) {
+        frame_edge_us = snap->edge_us;
+    }
+    INSTR_STAMP(start);
+    bool sent = draw_oled(disp, snap);
+    INSTR_SINCE(INSTR_OLED_DRAW, start);
+    instr_frame(disp, sent);
+    return sent;
+}
+#else
+static inline void instr_frame(ssd1306_t *disp, bool sent) { (void)disp; (void)sent; }
+static inline void instr_bus_idle(void) {}
+#define draw_oled_timed draw_oled
+#endif
+
+static display_power_t oled_power = DISPLAY_BRIGHT; // as the OLED is set up now, only used by the core that owns it
+
+// switch the panel on or off, or change its contrast, if power is different to what it is now.
+// these commands wait for the bus, but they only go out when the bike is left or comes back.
+// returns false if the panel is off, so there is no point drawing anything
+static bool set_power(ssd1306_t *disp, display_power_t power) {
+    if (power != oled_power) {
+        if (oled_power == DISPLAY_OFF) {
+            ssd1306_poweron(disp);
+        }
+        if (power == DISPLAY_OFF) {
+            ssd1306_poweroff(disp);
+        } else {
+            ssd1306_contrast(disp, power == DISPLAY_DIM ? DISPLAY_CONTRAST_DIM : DISPLAY_CONTRAST_BRIGHT);
+        }
+        oled_power = power;
+    }
+    return power != DISPLAY_OFF;
+}
+
+void display_init_oled(ssd1306_t *disp) {
+    i2c_init(DISPLAY_I2C, 400000);
+    gpio_set_function(DISPLAY_I2C_SCL, GPIO_FUNC_I2C);
+    gpio_set_function(DISPLAY_I2C_SDA, GPIO_FUNC_I2C);
+    gpio_pull_up(DISPLAY_I2C_SCL);
+    gpio_pull_up(DISPLAY_I2C_SDA);
+
+    disp->external_vcc=false;
+    ssd1306_init(disp, 128, 64, 0x3C, DISPLAY_I2C);
+}
+
+#if OLED_ON_CORE1
+
+// seqlock: core0 is the only writer, it makes seq odd while it is changing the snapshot and
+// even again after. core1 copies the snapshot out and tries again if seq moved while copying.
+// core0 never waits for core1, and core1 always ends up with a complete snapshot
+static volatile uint32_t snap_seq = 0;
+static ride_snapshot_t snap_shared;
+
+bool display_update(const ride_snapshot_t *snap) {
+    snap_seq++;
+    __dmb();
+    snap_shared = *snap;
+    __dmb();
+    snap_seq++;
+    __sev(); // wake core1 up
+    return false;
+}
+
+// returns the sequence number of the snapshot that was copied
+static uint32_t read_snapshot(ride_snapshot_t *snap) {
+    uint32_t seq;
+    do {
+        seq = snap_seq;
+        __dmb();
+        *snap = snap_shared;
+        __dmb();
+    } while ((seq & 1) || seq != snap_seq);
+    return seq;
+}
+
+static void core1_main(void) {
+    // let core0 pause this core while it writes to flash (see ride_log.c)
+    flash_safe_execute_core_init();
+
+    // core1 owns the OLED, nothing on core0 touches it
+    ssd1306_t disp;
+    display_init_oled(&disp);
+    draw_splash(&disp);
+    ssd1306_show(&disp);
+
+    uint32_t drawn_seq = 0; // the splash stays up until core0 publishes the first snapshot
+    while (1) {
+        if (snap_seq == drawn_seq) {
+            __wfe(); // sleep until core0 publishes something
+            continue;
+        }
+        ride_snapshot_t snap;
+        drawn_seq = read_snapshot(&snap);
+        if (!set_power(&disp, snap.power)) {
+            continue;
+        }
+        draw_oled_timed(&disp, &snap);
+        // waiting for it to go out is fine here, snapshots published in the meantime are skipped to the latest one
+        ssd1306_show(&disp);
+        instr_bus_idle();
+    }
+}
+
+void display_init(void) {
+    multicore_launch_core1(core1_main);
+}
+
+bool display_poll(void) {
+    return false;
+}
+
+#else
+
+static ssd1306_t disp;
+static bool oled_pending = false; // if a drawn frame is still waiting to be sent
+
+void display_init(void) {
+    display_init_oled(&disp);
+    draw_splash(&disp);
+    oled_pending = !ssd1306_show_async(&disp);
+}
+
+bool display_update(const ride_snapshot_t *snap) {
+    if (!set_power(&disp, snap->power)) {
+        oled_pending = false; // it will be drawn again when the panel comes back on
+        return false;
+    }
+    oled_pending = !draw_oled_timed(&disp, snap);
+    return oled_pending;
+}
+
+bool display_poll(void) {
+    // send a frame that was drawn while the OLED was still busy with the previous one
+    if (oled_pending) {
+        if (!ssd1306_is_busy(&disp)) {
+            instr_bus_idle(); // only seen for the frames something was waiting on, to within OLED_RETRY_US
+        }
+        bool sent = ssd1306_show_async(&disp);
+        instr_frame(&disp, sent);
+        oled_pending = !sent;
+    }
+    return oled_pending;
+}
+
+#endif
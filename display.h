@@ -0,0 +1,70 @@
+#ifndef _inc_display
+#define _inc_display
+
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+#include "extern/pico-ssd1306/src/ssd1306.h"
+#include "glyph_atlas.h" // generated at build time, see tools/glyph_atlas.py
+
+#define DISPLAY_I2C i2c0
+#define DISPLAY_I2C_SCL 5
+#define DISPLAY_I2C_SDA 4
+
+// run the OLED on core1, so however long rendering takes it can't delay anything on core0
+#ifndef OLED_ON_CORE1
+#define OLED_ON_CORE1 1
+#endif
+
+// how brightly the OLED is lit, it is dimmed then switched off when the bike has been left for a while
+typedef enum {
+    DISPLAY_BRIGHT = 0,
+    DISPLAY_DIM,
+    DISPLAY_OFF, // panel switched off, nothing is drawn
+} display_power_t;
+
+// everything shown on the OLED - the mainloop publishes a whole new one whenever something changes
+typedef struct {
+    int dist; // distance in meters
+    int mins_all; // minutes since power on
+    int mins_moving; // minutes in motion
+    int av_speed; // average moving speed in km/h
+    int max_speed; // highest speed in km/h
+    int curr_speed_miles; // current speed in mph
+    int cadence; // crank rpm, 0 when not pedalling
+    uint8_t wheel_frame; // 0, or a frame (from 1) of the spinning wheel to show in place of the current speed
+    uint64_t edge_us; // time of the reed switch edge this is showing the speed from, 0 if it isn't (see instr.h)
+    display_power_t power;
+} ride_snapshot_t;
+
+// the panel's contrast for each display_power_t
+#define DISPLAY_CONTRAST_BRIGHT 0xFF
+#define DISPLAY_CONTRAST_DIM 0x08
+
+// copies s into the buffer from an atlas, the top of it at page (y/8), and returns the x just after it.
+// characters the atlas doesn't have are left blank
+uint32_t draw_text(ssd1306_t *disp, uint32_t x, uint32_t page, const glyph_atlas_t *atlas, const char *s);
+
+// draws the stats and starts sending them to the OLED in the background, returns false if the
+// previous frame was still being sent (the new frame is left in the buffer to be sent later).
+// only what changed since the last call is redrawn, the rest is left in the buffer as it was
+bool draw_oled(ssd1306_t *disp, const ride_snapshot_t *snap);
+
+// the buffer has had something else drawn in it, so the next draw_oled starts again from a blank screen
+void draw_oled_invalidate(void);
+
+// set up the i2c bus and the OLED into disp (display_init does this on whichever core owns the OLED)
+void display_init_oled(ssd1306_t *disp);
+
+// set up the OLED (on whichever core owns it) and show the splash screen until the first snapshot
+void display_init(void);
+
+// show a new snapshot - never waits for the OLED, only the latest snapshot is guaranteed to be drawn.
+// returns true if it couldn't be sent yet, and display_poll needs calling
+bool display_update(const ride_snapshot_t *snap);
+
+// finishes off anything that couldn't be done in display_update, returns true if it still needs calling again
+// (in a few ms, when the previous frame has gone out)
+bool display_poll(void);
+
+#endif
@@ -0,0 +1,159 @@
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "edge_filter.h"
+
+// the alpha-beta filter gives up believing accelerations bigger than this
+#define MAX_ACCEL_Q8 (100 << SPEED_FRAC_BITS)
+
+void edge_filter_init(edge_filter_t *f, const edge_filter_config_t *config) {
+    memset(f, 0, sizeof(*f));
+    f->config = *config;
+    if (f->config.window < 1) {
+        f->config.window = 1;
+    }
+    if (f->config.window > SPEED_FILTER_MAX_WINDOW) {
+        f->config.window = SPEED_FILTER_MAX_WINDOW;
+    }
+    if (f->config.magnets < 1) {
+        f->config.magnets = 1;
+    }
+    if (f->config.magnets > EDGE_FILTER_MAX_MAGNETS) {
+        f->config.magnets = EDGE_FILTER_MAX_MAGNETS;
+    }
+    // until it knows better, they are equally spaced (any left over goes on the first gap)
+    for (uint32_t i = 0; i < f->config.magnets; i++) {
+        f->spacing[i] = REV_ARC / f->config.magnets;
+    }
+    f->spacing[0] += REV_ARC % f->config.magnets;
+    f->magnet = f->config.magnets - 1; // so the first one seen is 0
+}
+
+void edge_filter_stop(edge_filter_t *f) {
+    f->moving = false;
+    f->speed = 0;
+    f->accel_q8 = 0;
+    f->count = 0;
+    f->sum = 0;
+    f->arc_sum = 0;
+    f->gaps = 0;
+}
+
+static int32_t clamp(int32_t v, int32_t limit) {
+    return v > limit ? limit : v < -limit ? -limit : v;
+}
+
+// once there is a whole revolution of gaps, the one just timed took its share of that revolution's time,
+// which (unless the speed changed a lot during it) is its share of the circumference
+static void learn_spacing(edge_filter_t *f) {
+    uint32_t n = f->config.magnets;
+    f->gap_us[f->magnet] = f->interval_us;
+    if (++f->gaps < n) {
+        return;
+    }
+    uint64_t rev_us = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        rev_us += f->gap_us[i];
+    }
+    if (!rev_us) {
+        return;
+    }
+    int32_t measured = (int32_t)((uint64_t)f->interval_us * REV_ARC / rev_us);
+    int32_t gap = (int32_t)f->spacing[f->magnet];
+    f->spacing[f->magnet] = gap + (measured - gap) / (1 << EDGE_FILTER_SPACING_SHIFT);
+
+    // scale them all back to adding up to a revolution, so the distance comes out right
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        total += f->spacing[i];
+    }
+    uint32_t scaled = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        f->spacing[i] = (uint64_t)f->spacing[i] * REV_ARC / total;
+        scaled += f->spacing[i];
+    }
+    f->spacing[f->magnet] += REV_ARC - scaled;
+}
+
+static void update_speed(edge_filter_t *f) {
+    speed_q8_t measured = speed_from_arc_us(f->arc_q16, f->interval_us);
+    uint32_t dt_ms = f->interval_us / 1000 ? f->interval_us / 1000 : 1;
+    bool first = f->count == 0;
+    speed_q8_t prev = f->speed;
+
+    // the last `window` intervals, in a ring
+    uint32_t slot = f->count % f->config.window;
+    if (f->count >= f->config.window) {
+        f->sum -= f->intervals[slot];
+        f->arc_sum -= f->arcs[slot];
+    }
+    f->intervals[slot] = f->interval_us;
+    f->arcs[slot] = f->arc_q16;
+    f->sum += f->interval_us;
+    f->arc_sum += f->arc_q16;
+    f->count++;
+
+    if (first) {
+        f->speed = measured;
+        f->accel_q8 = 0;
+        return;
+    }
+
+    switch (f->config.type) {
+    case SPEED_FILTER_NONE:
+        f->speed = measured;
+        break;
+    case SPEED_FILTER_MOVING_AVERAGE:
+        f->speed = speed_from_arc_us(f->arc_sum, f->sum);
+        break;
+    case SPEED_FILTER_ALPHA_BETA: {
+        // predict where the speed got to from the acceleration, then correct towards what was measured
+        int32_t predicted = (int32_t)f->speed + f->accel_q8 * (int32_t)dt_ms / 1000;
+        int32_t residual = (int32_t)measured - predicted;
+        int32_t v = predicted + residual * (int32_t)f->config.alpha_q8 / 256;
+        f->speed = v > 0 ? v : 0;
+        f->accel_q8 = clamp(f->accel_q8 + residual * (int32_t)f->config.beta_q8 / 256 * 1000 / (int32_t)dt_ms, MAX_ACCEL_Q8);
+        return;
+    }
+    }
+    f->accel_q8 = clamp(((int32_t)f->speed - (int32_t)prev) * 1000 / (int32_t)dt_ms, MAX_ACCEL_Q8);
+}
+
+edge_filter_event_t edge_filter_push(edge_filter_t *f, const reed_edge_t *edge) {
+    if (!edge->closed) {
+        if (f->closed) {
+            f->closed = false;
+            f->opened_us = edge->time_us;
+        }
+        return EDGE_FILTER_NONE;
+    }
+    if (f->closed) {
+        return EDGE_FILTER_NONE;
+    }
+    f->closed = true;
+
+    // only a new revolution if the reed was open long enough to not just be bouncing
+    if (edge->time_us - f->opened_us < f->config.settle_us ||
+        (f->moving && edge->time_us - f->rev_us < f->config.holdoff_us)) {
+        return EDGE_FILTER_NONE;
+    }
+
+    // the next magnet round, even after stopping (the wheel stopped where it was)
+    f->magnet = f->magnet + 1u < f->config.magnets ? f->magnet + 1 : 0;
+    f->arc_q16 = f->spacing[f->magnet];
+
+    if (!f->moving) {
+        f->moving = true;
+        f->rev_us = edge->time_us;
+        f->interval_us = 0;
+        return EDGE_FILTER_START;
+    }
+    uint64_t interval = edge->time_us - f->rev_us;
+    f->interval_us = interval > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)interval;
+    f->rev_us = edge->time_us;
+    update_speed(f);
+    if (f->config.magnets > 1) {
+        learn_spacing(f); // after the speed, which went by what it knew before this gap
+    }
+    return EDGE_FILTER_REV;
+}
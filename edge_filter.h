@@ -0,0 +1,112 @@
+#ifndef _inc_edge_filter
+#define _inc_edge_filter
+
+#include "pico/stdlib.h"
+#include "reed.h"
+#include "speed.h"
+
+// turns the raw reed switch edges into wheel revolutions and a smoothed speed. it only looks at the
+// edge timestamps, so it never has to wait for the contacts to stop bouncing.
+//
+// with several magnets on the wheel, every one going past is a "revolution" here, just a part of a real one:
+// arc_q16 says how much. the magnets are meant to be equally spaced, but won't be exactly, so it learns how
+// far apart they really are. once it has been going round for a whole revolution, each gap's share of the
+// time that revolution took is its share of the circumference (at a steady speed), and that is averaged in
+// a bit at a time. the gaps are counted from whichever magnet it saw first, so a magnet it misses shifts them
+// all round by one until it has learnt them again
+
+typedef enum {
+    SPEED_FILTER_NONE,           // every revolution's own speed, as it is
+    SPEED_FILTER_MOVING_AVERAGE, // distance over time for the last `window` revolutions
+    SPEED_FILTER_ALPHA_BETA,     // tracks speed and acceleration, following changes quicker than an average
+} speed_filter_type_t;
+
+// most revolutions the moving average can be over
+#define SPEED_FILTER_MAX_WINDOW 16
+
+// most magnets there can be on the wheel
+#define EDGE_FILTER_MAX_MAGNETS 8
+
+// a gap's measured share of a revolution goes into what it has learnt 1/2^EDGE_FILTER_SPACING_SHIFT at a time
+#define EDGE_FILTER_SPACING_SHIFT 3
+
+typedef struct {
+    uint32_t settle_us;  // the reed switch must have been open this long before closing counts as a revolution
+                         // (anything shorter is the contacts bouncing as the magnet leaves)
+    uint32_t holdoff_us; // and it must be this long since the last revolution (the contacts bouncing as it
+                         // arrives). this is what limits the top speed: 5ms is ~1600 km/h over the number of magnets
+    uint32_t magnets;    // on the wheel, 0 is the same as 1
+    speed_filter_type_t type;
+    uint32_t window;     // for SPEED_FILTER_MOVING_AVERAGE, in magnets going past
+    uint32_t alpha_q8;   // for SPEED_FILTER_ALPHA_BETA, how much of each new speed to take (out of 256)
+    uint32_t beta_q8;    // and how much of the difference goes into the acceleration
+} edge_filter_config_t;
+
+// what spedo runs with, here so host/spedo_accuracy.c checks the same thing
+#define EDGE_FILTER_CONFIG_SPEDO {   \
+    .settle_us = 2000,               \
+    .holdoff_us = 5000,              \
+    .magnets = WHEEL_MAGNETS,        \
+    .type = SPEED_FILTER_ALPHA_BETA, \
+    .window = 4,                     \
+    .alpha_q8 = 128,                 \
+    .beta_q8 = 32,                   \
+}
+
+// and how slow a revolution has to be before it decides the wheel has stopped, and calls edge_filter_stop
+// (see edge_filter_due_us)
+#define EDGE_FILTER_STOPPED_AFTER_US 10000000
+
+typedef enum {
+    EDGE_FILTER_NONE,  // nothing new
+    EDGE_FILTER_START, // the first revolution since stopping, there is nothing to time it from yet
+    EDGE_FILTER_REV,   // a revolution, the speed has been updated
+} edge_filter_event_t;
+
+typedef struct {
+    edge_filter_config_t config;
+
+    // outputs, as of the last revolution (a magnet going past)
+    uint64_t rev_us;      // when it happened
+    uint32_t interval_us; // how long it took, exactly
+    uint32_t arc_q16;     // how far round the wheel it was, out of REV_ARC
+    uint8_t magnet;       // which magnet it was, counting from the first one seen
+    speed_q8_t speed;     // smoothed speed
+    int32_t accel_q8;     // smoothed acceleration, in km/h per second (Q8)
+    bool closed;          // the reed switch is closed
+
+    // internals
+    uint64_t opened_us;
+    bool moving;
+    uint32_t intervals[SPEED_FILTER_MAX_WINDOW];
+    uint32_t arcs[SPEED_FILTER_MAX_WINDOW]; // and how far round each of them was
+    uint32_t count;
+    uint64_t sum;
+    uint64_t arc_sum;
+    uint32_t spacing[EDGE_FILTER_MAX_MAGNETS]; // the gap ending at each magnet, out of REV_ARC (they add up to it)
+    uint32_t gap_us[EDGE_FILTER_MAX_MAGNETS];  // how long each gap last took
+    uint32_t gaps;                             // timed in a row, so the ones in gap_us are a whole revolution
+} edge_filter_t;
+
+void edge_filter_init(edge_filter_t *f, const edge_filter_config_t *config);
+
+// take in the next edge
+edge_filter_event_t edge_filter_push(edge_filter_t *f, const reed_edge_t *edge);
+
+// the wheel has stopped, so the next revolution can't be timed from the last one
+void edge_filter_stop(edge_filter_t *f);
+
+// when the next magnet should have gone past by, if the wheel is still doing a revolution at least every
+// rev_us. with more magnets the stop and zero timeouts go off that much sooner
+static inline uint64_t edge_filter_due_us(const edge_filter_t *f, uint32_t rev_us) {
+    uint32_t next = f->magnet + 1u < f->config.magnets ? f->magnet + 1u : 0;
+    return f->rev_us + (uint64_t)rev_us * f->spacing[next] / REV_ARC;
+}
+
+// the smoothed speed as revolutions per minute, for when it isn't a wheel (the cranks, for cadence).
+// the speed is WHEEL_CIRCUMFERENCE_MM*3600/interval, so undo that rather than keeping another average
+static inline uint32_t edge_filter_rpm(const edge_filter_t *f) {
+    return ((uint64_t)f->speed * 60000000u + VELOCITY_CONSTANT_Q8 / 2) / VELOCITY_CONSTANT_Q8;
+}
+
+#endif
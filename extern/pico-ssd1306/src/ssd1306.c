@@ -25,37 +25,72 @@ SOFTWARE.
 
 #include <pico/stdlib.h>
 #include <hardware/i2c.h>
+#include <hardware/dma.h>
 #include <pico/binary_info.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
 
 #include "ssd1306.h"
 #include "font.h"
 
 inline static void swap(int32_t *a, int32_t *b) {
-    int32_t *t=a;
+    int32_t t=*a;
     *a=*b;
-    *b=*t;
+    *b=t;
 }
 
-inline static void fancy_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, char *name) {
-    switch(i2c_write_blocking(i2c, addr, src, len, false)) {
-    case PICO_ERROR_GENERIC:
-        printf("[%s] addr not acknowledged!\n", name);
-        break;
-    case PICO_ERROR_TIMEOUT:
-        printf("[%s] timeout!\n", name);
-        break;
-    default:
-        //printf("[%s] wrote successfully %lu bytes!\n", name, len);
-        break;
+// room at the start of the dma stream for commands queued up to go out ahead of the next frame
+// (the configuration from ssd1306_init, or the switch on after it)
+#define SSD1306_TXBUF_CMD_WORDS 32
+
+// worst case size of a frame's dma stream: every page dirty, each with its 6 addressing commands
+// (control byte + commands) and its data (control byte + row), plus the queued commands
+#define SSD1306_TXBUF_WORDS(p) ((p)->pages*(1+6+1+(p)->width)+SSD1306_TXBUF_CMD_WORDS)
+
+static void ssd1306_check_abort(ssd1306_t *p) {
+    i2c_hw_t *hw=i2c_get_hw(p->i2c_i);
+    if(hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        (void) hw->clr_tx_abrt;
+        // only counted, stdio may be carrying binary telemetry (spedo reports it as the i2c_aborts counter)
+        ++p->aborts;
+        // whatever was left of the frame didn't arrive
+        ssd1306_invalidate(p);
     }
 }
 
-inline static void ssd1306_write(ssd1306_t *p, uint8_t val) {
-    uint8_t d[2]= {0x00, val};
-    fancy_write(p->i2c_i, p->address, d, 2, "ssd1306_write");
+static void ssd1306_wait(ssd1306_t *p) {
+    while(ssd1306_is_busy(p))
+        tight_loop_contents();
+    ssd1306_check_abort(p);
+}
+
+// add one i2c transaction (control byte followed by data) to a dma stream, with a stop after the last byte
+// so the next transaction in the stream starts with a new start condition
+static uint16_t *ssd1306_queue_transaction(uint16_t *out, uint8_t control, const uint8_t *src, size_t len) {
+    *(out++)=control;
+    for(size_t i=0; i<len; ++i)
+        *(out++)=src[i];
+    *(out-1)|=I2C_IC_DATA_CMD_STOP_BITS;
+    return out;
+}
+
+// start the dma on the first len words of txbuf, which go out one after the other
+static void ssd1306_send(ssd1306_t *p, size_t len) {
+    // same as the sdk does before a blocking write
+    i2c_hw_t *hw=i2c_get_hw(p->i2c_i);
+    hw->enable=0;
+    hw->tar=p->address;
+    hw->enable=1;
+
+    dma_channel_transfer_from_buffer_now(p->dma_chan, p->txbuf, len);
+    p->txqueued=0;
+}
+
+void ssd1306_commands(ssd1306_t *p, const uint8_t *cmds, size_t len) {
+    ssd1306_wait(p);
+    // all of them after one control byte (Co=0, D/C#=0), rather than a transaction each
+    uint16_t *out=ssd1306_queue_transaction(p->txbuf+p->txqueued, 0x00, cmds, len);
+    ssd1306_send(p, out-p->txbuf);
 }
 
 bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance) {
@@ -73,10 +108,40 @@ bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address
         return false;
     }
 
+    if((p->shadow=malloc(p->bufsize))==NULL) {
+        free(p->buffer);
+        p->bufsize=0;
+        return false;
+    }
+
+    if((p->txbuf=malloc(SSD1306_TXBUF_WORDS(p)*sizeof(uint16_t)))==NULL) {
+        free(p->buffer);
+        free(p->shadow);
+        p->bufsize=0;
+        return false;
+    }
+
+    p->txlen=0;
+    p->txqueued=0;
+    p->power_on_pending=true;
+    p->aborts=0;
+
     ++(p->buffer);
 
+    // display ram content is unknown at power on
+    ssd1306_invalidate(p);
+
+    // frames are pushed into the i2c tx fifo by dma, one 16 bit data_cmd word per byte
+    p->dma_chan=dma_claim_unused_channel(true);
+    dma_channel_config c=dma_channel_get_default_config(p->dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, i2c_get_dreq(p->i2c_i, true));
+    dma_channel_configure(p->dma_chan, &c, &i2c_get_hw(p->i2c_i)->data_cmd, p->txbuf, 0, false);
+
     // from https://github.com/makerportal/rpi-pico-ssd1306
-    int8_t cmds[]= {
+    uint8_t cmds[]= {
         SET_DISP | 0x00,  // off
         // address setting
         SET_MEM_ADDR,
@@ -106,34 +171,43 @@ bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address
         // charge pump
         SET_CHARGE_PUMP,
         p->external_vcc?0x10:0x14,
-        SET_DISP | 0x01
+        // switched on after the first frame (power_on_pending), so it never shows whatever was in its ram
     };
 
-    for(size_t i=0; i<sizeof(cmds); ++i)
-        ssd1306_write(p, cmds[i]);
+    // nothing is waited for here: the configuration goes out in one transaction at the head of the
+    // first frame's dma stream
+    p->txqueued=ssd1306_queue_transaction(p->txbuf, 0x00, cmds, sizeof(cmds))-p->txbuf;
 
     return true;
 }
 
 inline void ssd1306_deinit(ssd1306_t *p) {
+    dma_channel_unclaim(p->dma_chan);
     free(p->buffer-1);
+    free(p->shadow);
+    free(p->txbuf);
 }
 
 inline void ssd1306_poweroff(ssd1306_t *p) {
-    ssd1306_write(p, SET_DISP|0x00);
+    const uint8_t cmds[]= {SET_DISP|0x00};
+    p->power_on_pending=false;
+    ssd1306_commands(p, cmds, sizeof(cmds));
 }
 
 inline void ssd1306_poweron(ssd1306_t *p) {
-    ssd1306_write(p, SET_DISP|0x01);
+    const uint8_t cmds[]= {SET_DISP|0x01};
+    p->power_on_pending=false;
+    ssd1306_commands(p, cmds, sizeof(cmds));
 }
 
 inline void ssd1306_contrast(ssd1306_t *p, uint8_t val) {
-    ssd1306_write(p, SET_CONTRAST);
-    ssd1306_write(p, val);
+    const uint8_t cmds[]= {SET_CONTRAST, val};
+    ssd1306_commands(p, cmds, sizeof(cmds));
 }
 
 inline void ssd1306_invert(ssd1306_t *p, uint8_t inv) {
-    ssd1306_write(p, SET_NORM_INV | (inv & 1));
+    const uint8_t cmds[]= {SET_NORM_INV | (inv & 1)};
+    ssd1306_commands(p, cmds, sizeof(cmds));
 }
 
 inline void ssd1306_clear(ssd1306_t *p) {
@@ -146,33 +220,92 @@ void ssd1306_draw_pixel(ssd1306_t *p, uint32_t x, uint32_t y) {
     p->buffer[x+p->width*(y>>3)]|=0x1<<(y&0x07); // y>>3==y/8 && y&0x7==y%8
 }
 
+// fill the rectangle between x1,y1 and x2,y2 (inclusive, already clipped to the display) a page byte at
+// a time, only the top and bottom pages need masking
+static void ssd1306_fill_rect(ssd1306_t *p, uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2) {
+    const uint32_t first_page=y1>>3;
+    const uint32_t last_page=y2>>3;
+    const uint8_t top_mask=0xFF<<(y1&7);
+    const uint8_t bottom_mask=0xFF>>(7-(y2&7));
+    const uint32_t len=x2-x1+1;
+
+    for(uint32_t page=first_page; page<=last_page; ++page) {
+        uint8_t mask=0xFF;
+        if(page==first_page)
+            mask&=top_mask;
+        if(page==last_page)
+            mask&=bottom_mask;
+
+        uint8_t *row=p->buffer+page*p->width+x1;
+        if(mask==0xFF) {
+            memset(row, 0xFF, len);
+        } else {
+            for(uint32_t i=0; i<len; ++i)
+                row[i]|=mask;
+        }
+    }
+}
+
+// clip a span from a to b (inclusive, in any order) to 0..size-1, returns false if nothing is left
+static inline bool ssd1306_clip_span(int32_t *a, int32_t *b, int32_t size) {
+    if(*a>*b)
+        swap(a, b);
+    if(*b<0 || *a>=size)
+        return false;
+    if(*a<0)
+        *a=0;
+    if(*b>=size)
+        *b=size-1;
+    return true;
+}
+
 void ssd1306_draw_line(ssd1306_t *p, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
-    if(x1>x2) {
-        swap(&x1, &x2);
-        swap(&y1, &y2);
+    if(y1==y2) {
+        // horizontal: one masked byte per column
+        if(y1<0 || y1>=p->height || !ssd1306_clip_span(&x1, &x2, p->width))
+            return;
+        ssd1306_fill_rect(p, x1, y1, x2, y1);
+        return;
     }
 
     if(x1==x2) {
-        if(y1>y2)
-            swap(&y1, &y2);
-        for(int32_t i=y1; i<=y2; ++i)
-            ssd1306_draw_pixel(p, x1, i);
+        // vertical: whole page bytes, masked at the ends
+        if(x1<0 || x1>=p->width || !ssd1306_clip_span(&y1, &y2, p->height))
+            return;
+        ssd1306_fill_rect(p, x1, y1, x1, y2);
         return;
     }
 
-    float m=(float) (y2-y1) / (float) (x2-x1);
+    // bresenham, stepping one pixel at a time along whichever axis is longer so there are no gaps
+    const int32_t dx=x2>x1?x2-x1:x1-x2;
+    const int32_t dy=y2>y1?y1-y2:y2-y1; // negative
+    const int32_t sx=x2>x1?1:-1;
+    const int32_t sy=y2>y1?1:-1;
+    int32_t err=dx+dy;
 
-    for(int32_t i=x1; i<=x2; ++i) {
-        float y=m*(float) (i-x1)+(float) y1;
-        ssd1306_draw_pixel(p, i, (uint32_t) y);
+    for(;;) {
+        ssd1306_draw_pixel(p, x1, y1);
+        if(x1==x2 && y1==y2)
+            break;
+        const int32_t e2=2*err;
+        if(e2>=dy) {
+            err+=dy;
+            x1+=sx;
+        }
+        if(e2<=dx) {
+            err+=dx;
+            y1+=sy;
+        }
     }
 }
 
 void ssd1306_draw_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
-    for(uint32_t i=0; i<width; ++i)
-        for(uint32_t j=0; j<height; ++j)
-            ssd1306_draw_pixel(p, x+i, y+j);
+    if(!width || !height || x>=p->width || y>=p->height)
+        return;
 
+    uint32_t x2=width>p->width-x?p->width-1u:x+width-1;
+    uint32_t y2=height>p->height-y?p->height-1u:y+height-1;
+    ssd1306_fill_rect(p, x, y, x2, y2);
 }
 
 void ssd13606_draw_empty_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
@@ -182,17 +315,70 @@ void ssd13606_draw_empty_square(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t w
     ssd1306_draw_line(p, x+width, y, x+width, y+height);
 }
 
+// OR a column of pixels into the buffer, bit 0 of bits going at x,y and the rest below it
+// (a page byte at a time, rather than pixel by pixel)
+static inline void ssd1306_or_column(ssd1306_t *p, uint32_t x, uint32_t y, uint64_t bits) {
+    if(x>=p->width || y>=p->height)
+        return;
+
+    bits<<=y&7;
+    uint8_t *col=p->buffer+x+p->width*(y>>3);
+    for(uint32_t page=y>>3; bits && page<p->pages; ++page, col+=p->width, bits>>=8)
+        *col|=(uint8_t)bits;
+}
+
+// every bit of a nibble doubled, for scaling glyph columns by 2
+static const uint8_t ssd1306_double_nibble[16]= {
+    0x00, 0x03, 0x0C, 0x0F, 0x30, 0x33, 0x3C, 0x3F,
+    0xC0, 0xC3, 0xCC, 0xCF, 0xF0, 0xF3, 0xFC, 0xFF
+};
+
+// stretch a glyph column vertically, every bit repeated scale times
+static inline uint64_t ssd1306_scale_column(uint8_t line, uint32_t scale) {
+    if(scale==1)
+        return line;
+    if(scale==2)
+        return ssd1306_double_nibble[line&0x0F] | (ssd1306_double_nibble[line>>4]<<8);
+
+    const uint64_t block=(1ULL<<scale)-1;
+    uint64_t bits=0;
+    for(uint32_t j=0; line; ++j, line>>=1) {
+        if(line & 1)
+            bits|=block<<(j*scale);
+    }
+    return bits;
+}
+
 void ssd1306_draw_char_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, const uint8_t *font, char c) {
-    if(c > '~')
+    if(c < ' ' || c > '~')
         return;
 
-    for(uint8_t i=0; i<font[1]; ++i) {
-        uint8_t line=(uint8_t)(font[(c-0x20)*font[1]+i+2]);
+    const uint8_t *glyph=font+(c-0x20)*font[1]+2;
+
+    if(font[0]*scale+7>64) {
+        // too tall to do a column at a time, draw it square by square
+        for(uint8_t i=0; i<font[1]; ++i) {
+            uint8_t line=glyph[i];
 
-        for(int8_t j=0; j<font[0]; ++j, line>>=1) {
-            if(line & 1)
-                ssd1306_draw_square(p, x+i*scale, y+j*scale, scale, scale);
+            for(int8_t j=0; j<font[0]; ++j, line>>=1) {
+                if(line & 1)
+                    ssd1306_draw_square(p, x+i*scale, y+j*scale, scale, scale);
+            }
         }
+        return;
+    }
+
+    const uint8_t height_mask=font[0]>=8?0xFF:(1<<font[0])-1;
+
+    for(uint8_t i=0; i<font[1]; ++i) {
+        uint8_t line=glyph[i] & height_mask;
+        if(!line)
+            continue;
+
+        // the scaled column is worked out once, then written scale times
+        uint64_t bits=ssd1306_scale_column(line, scale);
+        for(uint32_t k=0; k<scale; ++k)
+            ssd1306_or_column(p, x+i*scale+k, y, bits);
     }
 }
 
@@ -210,6 +396,35 @@ void ssd1306_draw_string(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, c
     ssd1306_draw_string_with_font(p, x, y, scale, font_8x5, s);
 }
 
+void ssd1306_blit_pages(ssd1306_t *p, uint32_t x, uint32_t page, const uint8_t *src, uint32_t width, uint32_t pages) {
+    if(x>=p->width || page>=p->pages)
+        return;
+
+    uint32_t copy=width;
+    if(copy>p->width-x)
+        copy=p->width-x;
+    if(pages>p->pages-page)
+        pages=p->pages-page;
+
+    uint8_t *dst=p->buffer+x+p->width*page;
+    for(uint32_t i=0; i<pages; ++i, dst+=p->width, src+=width)
+        memcpy(dst, src, copy);
+}
+
+void ssd1306_clear_pages(ssd1306_t *p, uint32_t x, uint32_t page, uint32_t width, uint32_t pages) {
+    if(x>=p->width || page>=p->pages)
+        return;
+
+    if(width>p->width-x)
+        width=p->width-x;
+    if(pages>p->pages-page)
+        pages=p->pages-page;
+
+    uint8_t *dst=p->buffer+x+p->width*page;
+    for(uint32_t i=0; i<pages; ++i, dst+=p->width)
+        memset(dst, 0, width);
+}
+
 static inline uint32_t ssd1306_bmp_get_val(const uint8_t *data, const size_t offset, uint8_t size) {
     switch(size) {
     case 1:
@@ -272,17 +487,72 @@ inline void ssd1306_bmp_show_image(ssd1306_t *p, const uint8_t *data, const long
     ssd1306_bmp_show_image_with_offset(p, data, size, 0, 0);
 }
 
-void ssd1306_show(ssd1306_t *p) {
-    uint8_t payload[]= {SET_COL_ADDR, 0, p->width-1, SET_PAGE_ADDR, 0, p->pages-1};
-    if(p->width==64) {
-        payload[1]+=32;
-        payload[2]+=32;
+void ssd1306_invalidate(ssd1306_t *p) {
+    // a shadow that just differs from the buffer isn't enough, whatever gets drawn before the next frame
+    // could happen to match it
+    p->resend=true;
+}
+
+bool ssd1306_is_busy(ssd1306_t *p) {
+    if(dma_channel_is_busy(p->dma_chan))
+        return true;
+
+    // dma is done as soon as the last byte is in the fifo, it still has to go out on the bus
+    i2c_hw_t *hw=i2c_get_hw(p->i2c_i);
+    return !(hw->status & I2C_IC_STATUS_TFE_BITS) || (hw->status & I2C_IC_STATUS_MST_ACTIVITY_BITS);
+}
+
+bool ssd1306_show_async(ssd1306_t *p) {
+    if(ssd1306_is_busy(p))
+        return false;
+    ssd1306_check_abort(p);
+
+    const uint8_t col_offset=p->width==64?32:0;
+    const uint32_t width=p->width;
+    uint16_t *out=p->txbuf+p->txqueued;
+
+    for(uint8_t page=0; page<p->pages; ++page) {
+        uint8_t *row=p->buffer+page*p->width;
+        uint8_t *shadow_row=p->shadow+page*p->width;
+
+        // find the window of columns in this page that changed (all of them, if the panel's ram is unknown)
+        uint32_t first=0;
+        uint32_t last=width-1;
+        if(!p->resend) {
+            while(first<width && row[first]==shadow_row[first])
+                ++first;
+            if(first==width)
+                continue;
+            while(row[last]==shadow_row[last])
+                --last;
+        }
+
+        uint8_t payload[]= {SET_COL_ADDR, first+col_offset, last+col_offset, SET_PAGE_ADDR, page, page};
+        out=ssd1306_queue_transaction(out, 0x00, payload, sizeof(payload));
+
+        out=ssd1306_queue_transaction(out, 0x40, row+first, last-first+1);
+
+        memcpy(shadow_row+first, row+first, last-first+1);
     }
+    p->resend=false;
 
-    for(size_t i=0; i<sizeof(payload); ++i)
-        ssd1306_write(p, payload[i]);
+    if(p->power_on_pending) {
+        // the first frame is in the panel's ram now, so it can be switched on
+        const uint8_t on=SET_DISP|0x01;
+        out=ssd1306_queue_transaction(out, 0x00, &on, 1);
+        p->power_on_pending=false;
+    }
 
-    *(p->buffer-1)=0x40;
+    p->txlen=out-p->txbuf;
+    if(!p->txlen)
+        return true;
 
-    fancy_write(p->i2c_i, p->address, p->buffer-1, p->bufsize+1, "ssd1306_show");
+    ssd1306_send(p, p->txlen);
+    return true;
+}
+
+void ssd1306_show(ssd1306_t *p) {
+    ssd1306_wait(p);
+    ssd1306_show_async(p);
+    ssd1306_wait(p);
 }
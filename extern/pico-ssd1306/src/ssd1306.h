@@ -67,7 +67,15 @@ typedef struct {
     i2c_inst_t *i2c_i; 	/**< i2c connection instance */
     bool external_vcc; 	/**< whether display uses external vcc */ 
     uint8_t *buffer;	/**< display buffer */
+    uint8_t *shadow;	/**< copy of what was last sent to the display, used to only send what changed */
     size_t bufsize;		/**< buffer size */
+    uint16_t *txbuf;	/**< i2c command stream of the frame being sent, fed to the i2c tx fifo by dma */
+    size_t txlen;		/**< bytes in the i2c command stream of the last frame (not counting address bytes) */
+    size_t txqueued;	/**< words at the start of txbuf waiting to go out ahead of the next frame or commands */
+    bool power_on_pending;	/**< the panel is switched on after the next frame, so it has something to show */
+    bool resend;	/**< what is in the panel's ram isn't known, so the next frame sends every page in full */
+    uint32_t aborts;	/**< transfers the display didn't acknowledge, since initialization */
+    int dma_chan;		/**< dma channel used to send frames */
 } ssd1306_t;
 
 /**
@@ -78,6 +86,9 @@ typedef struct {
 *	@param[in] height : heigth of display
 *	@param[in] address : i2c address of display
 *	@param[in] i2c_instance : instance of i2c connection
+*
+*	doesn't wait for the bus: the configuration is queued up to go out in one transaction ahead of the
+*	first frame (or commands), and the panel is switched on once that first frame is in its ram
 *	
 * 	@return bool.
 *	@retval true for Success
@@ -85,6 +96,14 @@ typedef struct {
 */
 bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance);
 
+/**
+*	@brief deinitialize display, freeing its buffers and dma channel
+*
+*	@param[in] p : instance of display
+*
+*/
+void ssd1306_deinit(ssd1306_t *p);
+
 /**
 *	@brief turn off display
 *
@@ -110,6 +129,18 @@ void ssd1306_poweron(ssd1306_t *p);
 */
 void ssd1306_contrast(ssd1306_t *p, uint8_t val);
 
+/**
+	@brief send a sequence of commands (with their arguments) as one i2c transaction
+
+	waits for anything still being sent, then sends them in the background using dma
+
+	@param[in] p : instance of display
+	@param[in] cmds : commands and arguments, as in the datasheet
+	@param[in] len : number of bytes in cmds, up to a frame's worth
+
+*/
+void ssd1306_commands(ssd1306_t *p, const uint8_t *cmds, size_t len);
+
 /**
 	@brief set invert display
 
@@ -122,11 +153,46 @@ void ssd1306_invert(ssd1306_t *p, uint8_t inv);
 /**
 	@brief display buffer, should be called on change
 
+	only the columns of each page that differ from what was last sent are transmitted
+
 	@param[in] p : instance of display
 
 */
 void ssd1306_show(ssd1306_t *p);
 
+/**
+	@brief start sending buffer in the background using dma, returns without waiting
+
+	the changed data is copied out of the buffer before returning, so the next frame can be drawn
+	into the buffer straight away while this one is still being sent
+
+	@param[in] p : instance of display
+
+	@return bool.
+	@retval true if the frame was started (or nothing had changed)
+	@retval false if the previous frame is still being sent, nothing was done
+*/
+bool ssd1306_show_async(ssd1306_t *p);
+
+/**
+	@brief check if a frame started with ssd1306_show_async is still being sent
+
+	@param[in] p : instance of display
+
+	@return bool.
+	@retval true if still sending
+*/
+bool ssd1306_is_busy(ssd1306_t *p);
+
+/**
+	@brief forget what was last sent, so the next ssd1306_show sends the whole buffer, every page in full,
+	whatever is in it (the shadow is only compared against again after that)
+
+	@param[in] p : instance of display
+
+*/
+void ssd1306_invalidate(ssd1306_t *p);
+
 /**
 	@brief clear display buffer
 
@@ -243,4 +309,30 @@ void ssd1306_draw_string_with_font(ssd1306_t *p, uint32_t x, uint32_t y, uint32_
 */
 void ssd1306_draw_string(ssd1306_t *p, uint32_t x, uint32_t y, uint32_t scale, char *s);
 
+/**
+	@brief copy pre-rendered columns straight into the buffer at a page boundary
+
+	src is in the buffer's own format: rows of width bytes, one per page, each byte a column of 8 pixels with
+	the lowest bit at the top. whatever was under it is overwritten. anything off the display is clipped
+
+	@param[in] p : instance of display
+	@param[in] x : x position of the left column
+	@param[in] page : page (8 pixel row) of the top row
+	@param[in] src : width*pages bytes, top row first
+	@param[in] width : columns in each row
+	@param[in] pages : rows of 8 pixels
+*/
+void ssd1306_blit_pages(ssd1306_t *p, uint32_t x, uint32_t page, const uint8_t *src, uint32_t width, uint32_t pages);
+
+/**
+	@brief clear a box of whole pages, the page aligned counterpart of ssd1306_clear
+
+	@param[in] p : instance of display
+	@param[in] x : x position of the left column
+	@param[in] page : page (8 pixel row) of the top row
+	@param[in] width : columns to clear
+	@param[in] pages : rows of 8 pixels to clear
+*/
+void ssd1306_clear_pages(ssd1306_t *p, uint32_t x, uint32_t page, uint32_t width, uint32_t pages);
+
 #endif
@@ -0,0 +1,16 @@
+#ifndef _HARDWARE_CLOCKS_H
+#define _HARDWARE_CLOCKS_H
+
+#include "pico.h"
+
+enum clock_index {
+    clk_ref = 4,
+    clk_sys = 5,
+};
+
+// the simulated chip runs at the SDK's default 125MHz
+static inline uint32_t clock_get_hz(enum clock_index clk_index) {
+    return clk_index == clk_sys ? 125000000 : 12000000;
+}
+
+#endif
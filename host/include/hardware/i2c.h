@@ -0,0 +1,53 @@
+#ifndef _HARDWARE_I2C_H
+#define _HARDWARE_I2C_H
+
+#include "pico.h"
+
+// the registers the ssd1306 driver touches directly when sending by dma, the simulator keeps them up to date
+typedef struct {
+    volatile uint32_t enable;
+    volatile uint32_t tar;
+    volatile uint32_t data_cmd;
+    volatile uint32_t status;
+    volatile uint32_t raw_intr_stat;
+    volatile uint32_t clr_tx_abrt;
+    volatile uint32_t tx_abrt_source;
+    volatile uint32_t txflr;
+} i2c_hw_t;
+
+#define I2C_IC_DATA_CMD_RESTART_BITS 0x00000400u
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200u
+#define I2C_IC_DATA_CMD_CMD_BITS 0x00000100u
+#define I2C_IC_STATUS_MST_ACTIVITY_BITS 0x00000020u
+#define I2C_IC_STATUS_TFE_BITS 0x00000004u
+#define I2C_IC_STATUS_TFNF_BITS 0x00000002u
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x00000040u
+
+typedef struct i2c_inst {
+    i2c_hw_t *hw;
+    bool restart_on_next;
+} i2c_inst_t;
+
+extern i2c_inst_t i2c0_inst;
+extern i2c_inst_t i2c1_inst;
+
+#define i2c0 (&i2c0_inst)
+#define i2c1 (&i2c1_inst)
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+
+static inline i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) {
+    return i2c->hw;
+}
+
+static inline uint i2c_get_index(i2c_inst_t *i2c) {
+    return i2c == i2c1 ? 1 : 0;
+}
+
+// dreq numbers as on the RP2040
+static inline uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) {
+    return 32 + i2c_get_index(i2c) * 2 + (is_tx ? 0 : 1);
+}
+
+#endif
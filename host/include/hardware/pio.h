@@ -0,0 +1,107 @@
+#ifndef _HARDWARE_PIO_H
+#define _HARDWARE_PIO_H
+
+#include "pico.h"
+
+#define NUM_PIOS 2
+#define NUM_PIO_STATE_MACHINES 4
+#define PIO_INSTRUCTION_COUNT 32
+
+// the simulator doesn't run PIO code, see sim_pio.c. only the FIFOs are here, so DMA can be pointed at them
+typedef struct {
+    volatile uint32_t txf[NUM_PIO_STATE_MACHINES];
+    volatile uint32_t rxf[NUM_PIO_STATE_MACHINES];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+
+extern pio_hw_t sim_pio_hw[NUM_PIOS];
+#define pio0 (&sim_pio_hw[0])
+#define pio1 (&sim_pio_hw[1])
+
+typedef struct pio_program {
+    const uint16_t *instructions;
+    uint8_t length;
+    int8_t origin; // -1 for anywhere
+} pio_program_t;
+
+// the real thing packs these into the state machine's registers, the simulator only needs to read them back
+typedef struct {
+    uint32_t clkdiv_256; // clk_sys / state machine clock, in 1/256ths
+    uint wrap_target;
+    uint wrap;
+    uint jmp_pin;
+    uint out_base;
+    uint out_count;
+    bool out_shift_right;
+    bool autopull;
+    uint pull_threshold;
+    uint fifo_join;
+} pio_sm_config;
+
+enum pio_fifo_join {
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX = 1,
+    PIO_FIFO_JOIN_RX = 2,
+};
+
+enum pio_interrupt_source {
+    pis_interrupt0 = 8,
+    pis_interrupt1 = 9,
+    pis_interrupt2 = 10,
+    pis_interrupt3 = 11,
+};
+
+static inline pio_sm_config pio_get_default_sm_config(void) {
+    pio_sm_config c = { .clkdiv_256 = 256, .wrap_target = 0, .wrap = PIO_INSTRUCTION_COUNT - 1 };
+    return c;
+}
+
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap) {
+    c->wrap_target = wrap_target;
+    c->wrap = wrap;
+}
+
+static inline void sm_config_set_jmp_pin(pio_sm_config *c, uint pin) {
+    c->jmp_pin = pin;
+}
+
+static inline void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count) {
+    c->out_base = out_base;
+    c->out_count = out_count;
+}
+
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold) {
+    c->out_shift_right = shift_right;
+    c->autopull = autopull;
+    c->pull_threshold = pull_threshold;
+}
+
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join) {
+    c->fifo_join = join;
+}
+
+static inline void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t div_int, uint8_t div_frac) {
+    c->clkdiv_256 = ((uint32_t)div_int << 8) | div_frac;
+}
+
+static inline uint pio_get_index(PIO pio) {
+    return pio == pio1 ? 1 : 0;
+}
+
+static inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx) {
+    return pio_get_index(pio) * 8 + (is_tx ? 0 : 4) + sm; // DREQ_PIO0_TX0 is 0
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program);
+int pio_claim_unused_sm(PIO pio, bool required);
+void pio_gpio_init(PIO pio, uint pin);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_put(PIO pio, uint sm, uint32_t data);
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled);
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num);
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _HARDWARE_SYNC_H
+#define _HARDWARE_SYNC_H
+
+#include "pico.h"
+
+// there is only ever one thread in the simulator, so barriers just have to stop the compiler reordering
+static inline void __dmb(void) {
+    __compiler_memory_barrier();
+}
+
+static inline void __sev(void) {
+}
+
+// sleep until an interrupt (see sim.c). there is nothing else to send events, so both are the same
+void __wfe(void);
+
+static inline void __wfi(void) {
+    __wfe();
+}
+
+// interrupts that happen while they are disabled are held back until they are restored, like the NVIC
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+#endif
@@ -0,0 +1,20 @@
+// host stand-in for the Pico SDK, just enough of it for spedo to build and run on a PC (see host/sim.c)
+#ifndef _PICO_H
+#define _PICO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// same as the SDK's host platform, code that only makes sense on the real chip can check this
+#define PICO_ON_DEVICE 0
+
+// the flash chip on a pico (see hardware/flash.h)
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+
+#include "pico/types.h"
+#include "pico/platform.h"
+#include "pico/error.h"
+#include "pico/assert.h"
+
+#endif
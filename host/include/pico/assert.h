@@ -0,0 +1,9 @@
+#ifndef _PICO_ASSERT_H
+#define _PICO_ASSERT_H
+
+#include <assert.h>
+
+// the SDK only compiles these in for debug builds, the host build keeps them whenever assert does
+#define hard_assert(x) assert(x)
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef _PICO_BINARY_INFO_H
+#define _PICO_BINARY_INFO_H
+
+#define bi_decl(_decl)
+#define bi_decl_if_func_used(_decl)
+
+#endif
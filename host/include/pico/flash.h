@@ -0,0 +1,13 @@
+#ifndef _PICO_FLASH_H
+#define _PICO_FLASH_H
+
+#include "pico.h"
+
+// there is no other core to lock out, so this just runs func with interrupts disabled
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms);
+
+static inline bool flash_safe_execute_core_init(void) {
+    return true;
+}
+
+#endif
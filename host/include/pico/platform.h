@@ -0,0 +1,16 @@
+#ifndef _PICO_PLATFORM_H
+#define _PICO_PLATFORM_H
+
+#define __isr
+#define __not_in_flash_func(func_name) func_name
+#define __time_critical_func(func_name) func_name
+#define __force_inline inline __attribute__((always_inline))
+
+static inline void __compiler_memory_barrier(void) {
+    __asm__ volatile ("" : : : "memory");
+}
+
+// busy-wait loops call this every time round, so the simulated clock moves on while they wait
+void tight_loop_contents(void);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef _PICO_STDIO_H
+#define _PICO_STDIO_H
+
+#include <stdio.h>
+#include "pico.h"
+
+// stdout is just the PC's stdout
+bool stdio_init_all(void);
+
+static inline int putchar_raw(int c) {
+    return putchar(c);
+}
+
+// the next character typed on the USB serial port (see sim_add_input), or PICO_ERROR_TIMEOUT.
+// it doesn't wait for one, whatever the timeout
+int getchar_timeout_us(uint32_t timeout_us);
+
+#endif
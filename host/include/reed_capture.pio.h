@@ -0,0 +1,26 @@
+// host stand-in for the header pioasm generates from reed_capture.pio. the simulator doesn't run PIO
+// code (sim_pio.c models what the program does instead), so only the length and wrap are real, for
+// checking the program fits and the state machine is set up the way the firmware build would do it
+#ifndef _REED_CAPTURE_PIO_H
+#define _REED_CAPTURE_PIO_H
+
+#include "hardware/pio.h"
+
+#define reed_capture_wrap_target 2
+#define reed_capture_wrap 24
+
+static const uint16_t reed_capture_program_instructions[26] = { 0 };
+
+static const struct pio_program reed_capture_program = {
+    .instructions = reed_capture_program_instructions,
+    .length = 26,
+    .origin = -1,
+};
+
+static inline pio_sm_config reed_capture_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + reed_capture_wrap_target, offset + reed_capture_wrap);
+    return c;
+}
+
+#endif
@@ -0,0 +1,24 @@
+// host stand-in for the header pioasm generates from sevenseg_mux.pio, see reed_capture.pio.h
+#ifndef _SEVENSEG_MUX_PIO_H
+#define _SEVENSEG_MUX_PIO_H
+
+#include "hardware/pio.h"
+
+#define sevenseg_mux_wrap_target 0
+#define sevenseg_mux_wrap 6
+
+static const uint16_t sevenseg_mux_program_instructions[7] = { 0 };
+
+static const struct pio_program sevenseg_mux_program = {
+    .instructions = sevenseg_mux_program_instructions,
+    .length = 7,
+    .origin = -1,
+};
+
+static inline pio_sm_config sevenseg_mux_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + sevenseg_mux_wrap_target, offset + sevenseg_mux_wrap);
+    return c;
+}
+
+#endif
@@ -0,0 +1,192 @@
+// turns a ride log (see ride_log.c) back into a timeline, as csv on stdout.
+//
+// the input is either a whole flash image (like spedo_host's flash.bin) or just the log region, which
+// can be read off a pico with: picotool save -r 0x10180000 0x10200000 ride_log.bin
+//
+// by default there is a line per revolution:
+//   boot,ride,time_s,interval_us,speed_kmh,distance_m
+// where time_s counts from power on (there's no clock to say when that was) and distance is for the ride.
+// with --rides there is a line per ride instead:
+//   boot,ride,start_s,end_s,moving_s,distance_m,avg_kmh,max_kmh
+// with --stats the revolutions go through ride_stats like they do on the bike, and there is a line per boot
+// (ride_stats covers everything since power on) with its percentiles, best splits and time in each zone:
+//   boot,distance_m,moving_s,avg_kmh,max_kmh,p10_kmh,p50_kmh,p90_kmh,best_1km_s,best_5km_s,zone_0_s,zone_5_s...
+// and with --laps a line per lap as they are finished:
+//   boot,lap,moving_s,avg_kmh,max_kmh
+// the max speeds there are from each revolution as it is, where the bike's are smoothed.
+// with WHEEL_MAGNETS more than 1, each "revolution" is a magnet going past, taken to be an equal share of
+// the circumference (the bike learns how far apart they really are, but the log doesn't have that)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "ride_log.h"
+#include "ride_stats.h"
+#include "speed.h"
+
+// where the current ride got to
+typedef struct {
+    int boot;
+    int ride;
+    double start_s;
+    double time_s;
+    double moving_s;
+    uint32_t revs;
+    double max_kmh;
+} ride_t;
+
+static void print_ride(const ride_t *r) {
+    if (!r->revs) {
+        return;
+    }
+    double dist_m = r->revs * WHEEL_CIRCUMFERENCE / WHEEL_MAGNETS;
+    printf("%d,%d,%.3f,%.3f,%.3f,%.1f,%.2f,%.2f\n", r->boot, r->ride, r->start_s, r->time_s, r->moving_s,
+           dist_m, r->moving_s > 0 ? dist_m / r->moving_s * 3.6 : 0, r->max_kmh);
+}
+
+static double to_kmh(speed_q8_t v) {
+    return v / (double)(1 << SPEED_FRAC_BITS);
+}
+
+// how far round the wheel each magnet going past is
+#define MAGNET_ARC (REV_ARC / WHEEL_MAGNETS)
+
+static void print_stats(int boot, const ride_stats_t *s) {
+    if (!s->revs) {
+        return;
+    }
+    printf("%d,%.1f,%.3f,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f,%.3f", boot, s->dist_mm / 1000.0, s->moving_us / 1e6,
+           to_kmh(ride_stats_average(s)), to_kmh(s->max_speed), to_kmh(ride_stats_percentile(s, 10)),
+           to_kmh(ride_stats_percentile(s, 50)), to_kmh(ride_stats_percentile(s, 90)),
+           ride_stats_best_split_ms(s, RIDE_STATS_SPLIT_1KM) / 1000.0,
+           ride_stats_best_split_ms(s, RIDE_STATS_SPLIT_5KM) / 1000.0);
+    for (uint zone = 0; zone < RIDE_STATS_ZONES; zone++) {
+        printf(",%.3f", ride_stats_zone_ms(s, zone) / 1000.0);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    bool rides = false;
+    bool stats = false;
+    bool laps = false;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--rides")) {
+            rides = true;
+        } else if (!strcmp(argv[i], "--stats")) {
+            stats = true;
+        } else if (!strcmp(argv[i], "--laps")) {
+            laps = true;
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (!path || rides + stats + laps > 1) {
+        fprintf(stderr, "usage: %s [--rides | --stats | --laps] FLASH_IMAGE\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    uint8_t *image = malloc(PICO_FLASH_SIZE_BYTES);
+    size_t len = fread(image, 1, PICO_FLASH_SIZE_BYTES, f);
+    fclose(f);
+    const uint8_t *region;
+    if (len == PICO_FLASH_SIZE_BYTES) {
+        region = image + RIDE_LOG_OFFSET;
+    } else if (len == RIDE_LOG_SIZE) {
+        region = image;
+    } else {
+        fprintf(stderr, "%s is %zu bytes, expected a flash image (%u) or the ride log region (%u)\n",
+                path, len, PICO_FLASH_SIZE_BYTES, RIDE_LOG_SIZE);
+        return 1;
+    }
+
+    if (rides) {
+        printf("boot,ride,start_s,end_s,moving_s,distance_m,avg_kmh,max_kmh\n");
+    } else if (stats) {
+        printf("boot,distance_m,moving_s,avg_kmh,max_kmh,p10_kmh,p50_kmh,p90_kmh,best_1km_s,best_5km_s");
+        for (uint zone = 0; zone < RIDE_STATS_ZONES; zone++) {
+            printf(",zone_%u_s", zone * RIDE_STATS_ZONE_KMH);
+        }
+        printf("\n");
+    } else if (laps) {
+        printf("boot,lap,moving_s,avg_kmh,max_kmh\n");
+    } else {
+        printf("boot,ride,time_s,interval_us,speed_kmh,distance_m\n");
+    }
+
+    ride_log_reader_t reader;
+    ride_log_record_t rec;
+    ride_t ride = {0};
+    ride_stats_t ride_stats;
+    ride_stats_init(&ride_stats);
+    ride_log_reader_init(&reader, region);
+    while (ride_log_read(&reader, &rec)) {
+        switch (rec.type) {
+        case RIDE_LOG_BOOT:
+        case RIDE_LOG_START:
+            if (rides) {
+                print_ride(&ride);
+            }
+            if (rec.type == RIDE_LOG_BOOT) {
+                if (stats) {
+                    print_stats(ride.boot, &ride_stats);
+                }
+                ride_stats_init(&ride_stats);
+                ride.boot++;
+                ride.ride = 0;
+                ride.start_s = 0;
+            } else {
+                ride.ride++;
+                ride.start_s = rec.value / 1000.0;
+            }
+            ride.time_s = ride.start_s;
+            ride.moving_s = 0;
+            ride.revs = 0;
+            ride.max_kmh = 0;
+            break;
+        case RIDE_LOG_REV: {
+            double kmh = to_kmh(speed_from_arc_us(MAGNET_ARC, rec.value));
+            ride.time_s += rec.value / 1e6;
+            ride.moving_s += rec.value / 1e6;
+            ride.revs++;
+            if (kmh > ride.max_kmh) {
+                ride.max_kmh = kmh;
+            }
+            uint32_t laps_done = ride_stats.laps_done;
+            ride_stats_revolution(&ride_stats, MAGNET_ARC, rec.value, speed_from_arc_us(MAGNET_ARC, rec.value));
+            if (laps && ride_stats.laps_done != laps_done) {
+                const ride_stats_lap_t *lap = ride_stats_lap(&ride_stats, 0);
+                printf("%d,%lu,%.3f,%.2f,%.2f\n", ride.boot, (unsigned long)ride_stats.laps_done, lap->moving_ms / 1e3,
+                       RIDE_STATS_LAP_MM / 1000.0 / lap->moving_ms * 3600, to_kmh(lap->max_speed));
+            }
+            if (!rides && !stats && !laps) {
+                printf("%d,%d,%.6f,%lu,%.2f,%.1f\n", ride.boot, ride.ride, ride.time_s, (unsigned long)rec.value,
+                       kmh, ride.revs * WHEEL_CIRCUMFERENCE / WHEEL_MAGNETS);
+            }
+            break;
+        }
+        case RIDE_LOG_STOP:
+            ride.time_s = rec.value / 1000.0;
+            break;
+        }
+    }
+    if (rides) {
+        print_ride(&ride);
+    }
+    if (stats) {
+        print_stats(ride.boot, &ride_stats);
+    }
+    free(image);
+    return 0;
+}
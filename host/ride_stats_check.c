@@ -0,0 +1,102 @@
+// feeds ride_stats a ride of fixed wheel intervals and checks everything it works out against values done
+// by hand. the ride is 500 revolutions at each of 20, 30 and 10 km/h (intervals that are a whole number of us,
+// 8031600/kmh), 1500 * 2231mm = 3346.5m in 500 * (401580 + 267720 + 803160)us = 736.23s:
+//   zones        each revolution's interval rounded to a ms: 500 * 402ms in 20-25, 268 in 30-35, 803 in 10-15
+//   percentiles  10 km/h is most of the time, so the median is in it (368250 of its 401500ms in, 10.91 km/h),
+//                the 90th is 60350 of the 134000ms into 30 km/h (30.45 km/h)
+//   best 1km     the 50 checkpoints (of 9 revolutions) nearest 1km, all at 30 km/h: exactly 120s
+//   laps         1km: 449 revolutions at 20, then 51 at 20 + 397 at 30, then 103 at 30 + 345 at 10
+// a ride of only 3 revolutions at 20 km/h has to average exactly 20 km/h
+// and the same ride with 4 magnets on the wheel has to come out the same distance and moving time
+// exits with 1 if anything is out
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "ride_stats.h"
+
+#define KMH_20_US 401580
+#define KMH_30_US 267720
+#define KMH_10_US 803160
+#define REVS_EACH 500
+#define LAPS 3
+
+static ride_stats_t ride;
+static bool ok = true;
+
+static void expect(const char *what, uint64_t got, uint64_t want) {
+    printf("%-16s %10llu\n", what, (unsigned long long)got);
+    if (got != want) {
+        printf("FAIL %s: %llu, should be %llu\n", what, (unsigned long long)got, (unsigned long long)want);
+        ok = false;
+    }
+}
+
+// the ride, with magnets evenly round the wheel
+static void ride_trace(uint magnets) {
+    static const uint32_t intervals_us[] = {KMH_20_US, KMH_30_US, KMH_10_US};
+    ride_stats_init(&ride);
+    for (uint i = 0; i < sizeof(intervals_us) / sizeof(intervals_us[0]); i++) {
+        uint32_t interval_us = intervals_us[i] / magnets;
+        for (uint rev = 0; rev < REVS_EACH * magnets; rev++) {
+            ride_stats_revolution(&ride, REV_ARC / magnets, interval_us, speed_from_interval_us(intervals_us[i]));
+        }
+    }
+}
+
+int main(void) {
+    ride_trace(1);
+    expect("dist_mm", ride.dist_mm, 3346500);
+    expect("moving_us", ride.moving_us, 736230000);
+    expect("max_speed", ride.max_speed, 30 << SPEED_FRAC_BITS);
+    expect("average", ride_stats_average(&ride), 4189); // 3346.5m in 736.23s is 16.36 km/h
+
+    for (uint zone = 0; zone < RIDE_STATS_ZONES; zone++) {
+        uint32_t want = zone == 2 ? 401500 : zone == 4 ? 201000 : zone == 6 ? 134000 : 0;
+        char what[16];
+        snprintf(what, sizeof(what), "zone %u ms", zone);
+        expect(what, ride_stats_zone_ms(&ride, zone), want);
+    }
+
+    expect("50th percentile", ride_stats_percentile(&ride, 50), (10 << SPEED_FRAC_BITS) + 234);
+    expect("90th percentile", ride_stats_percentile(&ride, 90), (30 << SPEED_FRAC_BITS) + 115);
+
+    expect("best 1km ms", ride_stats_best_split_ms(&ride, RIDE_STATS_SPLIT_1KM), 120000);
+    expect("best 5km ms", ride_stats_best_split_ms(&ride, RIDE_STATS_SPLIT_5KM), 0); // not that far
+
+    static const struct {
+        uint32_t moving_ms;
+        uint32_t max_kmh;
+    } laps[LAPS] = {{180309, 20}, {126765, 30}, {304666, 30}}; // oldest first
+    expect("laps", ride.laps_done, LAPS);
+    for (uint i = 0; i < LAPS; i++) {
+        const ride_stats_lap_t *lap = ride_stats_lap(&ride, LAPS - 1 - i);
+        if (!lap) {
+            printf("FAIL lap %u missing\n", i + 1);
+            ok = false;
+            continue;
+        }
+        char what[16];
+        snprintf(what, sizeof(what), "lap %u ms", i + 1);
+        expect(what, lap->moving_ms, laps[i].moving_ms);
+        snprintf(what, sizeof(what), "lap %u max", i + 1);
+        expect(what, lap->max_speed, laps[i].max_kmh << SPEED_FRAC_BITS);
+    }
+    expect("lap 4", ride_stats_lap(&ride, LAPS) != NULL, 0);
+
+    // only a few revolutions in, the average is still exactly the speed (rounding the 1.2s down to 1 would
+    // make it 24 km/h)
+    ride_stats_init(&ride);
+    for (uint rev = 0; rev < 3; rev++) {
+        ride_stats_revolution(&ride, REV_ARC, KMH_20_US, speed_from_interval_us(KMH_20_US));
+    }
+    expect("short average", ride_stats_average(&ride), 20 << SPEED_FRAC_BITS);
+
+    ride_trace(4);
+    expect("4 magnets dist", ride.dist_mm, 3346500);
+    expect("4 magnets moving", ride.moving_us, 736230000);
+
+    printf(ok ? "all as expected\n" : "ride_stats has regressed\n");
+    return ok ? 0 : 1;
+}
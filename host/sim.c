@@ -0,0 +1,477 @@
+// the simulated chip: clock, gpio and reed switch edges. see spedo_host.c for how it is driven
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+
+#include "sim.h"
+
+uint64_t sim_now_us = 0;
+uint64_t sim_end_us = UINT64_MAX;
+const char *sim_out_dir = NULL;
+
+// EDGES ------------------------------------------------------------------------------
+
+typedef struct {
+    uint64_t time_us;
+    uint gpio;
+    bool level;
+} sim_edge_t;
+
+static sim_edge_t *edges = NULL;
+static size_t edge_count = 0;
+static size_t edge_cap = 0;
+static size_t next_edge = 0;
+
+void sim_add_edge(uint64_t time_us, uint gpio, bool level) {
+    if (edge_count == edge_cap) {
+        edge_cap = edge_cap ? edge_cap * 2 : 1024;
+        edges = realloc(edges, edge_cap * sizeof(sim_edge_t));
+        if (!edges) {
+            fprintf(stderr, "out of memory for trace\n");
+            exit(1);
+        }
+    }
+    edges[edge_count].time_us = time_us;
+    edges[edge_count].gpio = gpio;
+    edges[edge_count].level = level;
+    edge_count++;
+}
+
+static int compare_edges(const void *a, const void *b) {
+    const sim_edge_t *ea = a;
+    const sim_edge_t *eb = b;
+    if (ea->time_us != eb->time_us) {
+        return ea->time_us < eb->time_us ? -1 : 1;
+    }
+    return 0;
+}
+
+uint64_t sim_last_edge_us(void) {
+    uint64_t last = 0;
+    for (size_t i = 0; i < edge_count; i++) {
+        if (edges[i].time_us > last) {
+            last = edges[i].time_us;
+        }
+    }
+    return last;
+}
+
+void sim_write_edges(FILE *f) {
+    fprintf(f, "# time_us gpio level\n");
+    for (size_t i = 0; i < edge_count; i++) {
+        fprintf(f, "%llu %u %d\n", (unsigned long long)edges[i].time_us, edges[i].gpio, edges[i].level);
+    }
+}
+
+// GPIO -------------------------------------------------------------------------------
+
+static uint32_t gpio_out = 0;   // output latch
+static uint32_t gpio_in = ~0u;  // input levels, everything pulled up until the trace says otherwise
+static uint32_t gpio_dir = 0;   // 1 = output
+static uint32_t irq_events[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t irq_callback = NULL;
+static bool irqs_disabled = false;
+static uint32_t irq_pending[NUM_BANK0_GPIOS];       // events that happened while interrupts were disabled
+static uint64_t irq_pending_since[NUM_BANK0_GPIOS];
+static uint64_t max_irq_latency_us = 0;             // longest any interrupt was held back
+static irq_handler_t irq_handlers[NUM_IRQS];
+static uint32_t irq_enabled = 0;
+static uint32_t irq_latched = 0;                    // other interrupts raised while they were disabled
+static uint64_t irq_latched_since[NUM_IRQS];
+static bool sim_event = false;                      // an interrupt has happened, which would wake a wfe
+static uint64_t wakeups = 0;                        // times the firmware has woken up from waiting for one
+static FILE *outputs_log = NULL;
+
+static void outputs_changed(uint32_t old) {
+    if (old != gpio_out && outputs_log) {
+        fprintf(outputs_log, "%llu %08x\n", (unsigned long long)sim_now_us, gpio_out);
+    }
+}
+
+void gpio_init(uint gpio) {
+    gpio_dir &= ~(1u << gpio);
+    uint32_t old = gpio_out;
+    gpio_out &= ~(1u << gpio);
+    outputs_changed(old);
+}
+
+void gpio_init_mask(uint gpio_mask) {
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        if (gpio_mask & (1u << gpio)) {
+            gpio_init(gpio);
+        }
+    }
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    (void)gpio;
+    (void)fn;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    if (out) {
+        gpio_dir |= 1u << gpio;
+    } else {
+        gpio_dir &= ~(1u << gpio);
+    }
+}
+
+void gpio_set_dir_out_masked(uint32_t mask) {
+    gpio_dir |= mask;
+}
+
+void gpio_pull_up(uint gpio) {
+    (void)gpio;
+}
+
+void gpio_pull_down(uint gpio) {
+    (void)gpio;
+}
+
+void gpio_disable_pulls(uint gpio) {
+    (void)gpio;
+}
+
+bool gpio_get(uint gpio) {
+    return gpio_get_all() & (1u << gpio);
+}
+
+uint32_t gpio_get_all(void) {
+    return (gpio_in & ~gpio_dir) | (gpio_out & gpio_dir);
+}
+
+void gpio_put_masked(uint32_t mask, uint32_t value) {
+    uint32_t old = gpio_out;
+    gpio_out = (gpio_out & ~mask) | (value & mask);
+    outputs_changed(old);
+}
+
+void gpio_put(uint gpio, bool value) {
+    gpio_put_masked(1u << gpio, value ? ~0u : 0);
+}
+
+void gpio_set_mask(uint32_t mask) {
+    gpio_put_masked(mask, ~0u);
+}
+
+void gpio_clr_mask(uint32_t mask) {
+    gpio_put_masked(mask, 0);
+}
+
+void gpio_xor_mask(uint32_t mask) {
+    gpio_put_masked(mask, ~gpio_out);
+}
+
+void gpio_put_all(uint32_t value) {
+    gpio_put_masked(~0u, value);
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled) {
+    if (enabled) {
+        irq_events[gpio] |= events;
+    } else {
+        irq_events[gpio] &= ~events;
+    }
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback) {
+    gpio_set_irq_enabled(gpio, events, enabled);
+    if (enabled) {
+        irq_callback = callback;
+    }
+}
+
+// change an input pin, firing its interrupt if it is enabled for that edge
+static void drive_input(uint gpio, bool level) {
+    bool old = gpio_in & (1u << gpio);
+    if (old == level) {
+        return;
+    }
+    if (level) {
+        gpio_in |= 1u << gpio;
+    } else {
+        gpio_in &= ~(1u << gpio);
+    }
+    sim_pio_input(gpio, level);
+    uint32_t event = level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+    if (!(irq_events[gpio] & event) || !irq_callback) {
+        return;
+    }
+    if (irqs_disabled) {
+        // latched until interrupts are back on, when the callback gets every event that happened
+        if (!irq_pending[gpio]) {
+            irq_pending_since[gpio] = sim_now_us;
+        }
+        irq_pending[gpio] |= event;
+        return;
+    }
+    irq_callback(gpio, event);
+    sim_event = true;
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler) {
+    irq_handlers[num] = handler;
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    if (enabled) {
+        irq_enabled |= 1u << num;
+    } else {
+        irq_enabled &= ~(1u << num);
+    }
+}
+
+void sim_raise_irq(uint num) {
+    if (!(irq_enabled & (1u << num)) || !irq_handlers[num]) {
+        return;
+    }
+    if (irqs_disabled) {
+        if (!(irq_latched & (1u << num))) {
+            irq_latched_since[num] = sim_now_us;
+        }
+        irq_latched |= 1u << num;
+        return;
+    }
+    irq_handlers[num]();
+    sim_event = true;
+}
+
+uint32_t save_and_disable_interrupts(void) {
+    uint32_t status = irqs_disabled;
+    irqs_disabled = true;
+    return status;
+}
+
+void restore_interrupts(uint32_t status) {
+    irqs_disabled = status;
+    if (irqs_disabled) {
+        return;
+    }
+    for (uint gpio = 0; gpio < NUM_BANK0_GPIOS; gpio++) {
+        if (irq_pending[gpio]) {
+            uint32_t events = irq_pending[gpio];
+            irq_pending[gpio] = 0;
+            if (sim_now_us - irq_pending_since[gpio] > max_irq_latency_us) {
+                max_irq_latency_us = sim_now_us - irq_pending_since[gpio];
+            }
+            irq_callback(gpio, events);
+            sim_event = true;
+        }
+    }
+    for (uint num = 0; num < NUM_IRQS; num++) {
+        if (irq_latched & (1u << num)) {
+            irq_latched &= ~(1u << num);
+            if (sim_now_us - irq_latched_since[num] > max_irq_latency_us) {
+                max_irq_latency_us = sim_now_us - irq_latched_since[num];
+            }
+            irq_handlers[num]();
+            sim_event = true;
+        }
+    }
+}
+
+// USB SERIAL -------------------------------------------------------------------------
+
+typedef struct {
+    uint64_t time_us;
+    char c;
+} sim_input_t;
+
+static sim_input_t *inputs = NULL;
+static size_t input_count = 0;
+static size_t input_arrived = 0; // characters that have been typed by now
+static size_t input_read = 0;    // and that the firmware has read
+
+void sim_add_input(uint64_t time_us, const char *text) {
+    size_t len = strlen(text);
+    inputs = realloc(inputs, (input_count + len) * sizeof(sim_input_t));
+    if (!inputs) {
+        fprintf(stderr, "out of memory for input\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < len; i++) {
+        inputs[input_count].time_us = time_us;
+        inputs[input_count].c = text[i];
+        input_count++;
+    }
+}
+
+int getchar_timeout_us(uint32_t timeout_us) {
+    (void)timeout_us;
+    if (input_read == input_arrived) {
+        return PICO_ERROR_TIMEOUT;
+    }
+    return (unsigned char)inputs[input_read++].c;
+}
+
+// TIME -------------------------------------------------------------------------------
+
+// the soonest any of the peripheral models (or the next character typed) has something to do
+static uint64_t peripherals_next_event(void) {
+    uint64_t i2c = sim_i2c_next_event();
+    uint64_t pio = sim_pio_next_event();
+    uint64_t next = i2c < pio ? i2c : pio;
+    if (input_arrived < input_count && inputs[input_arrived].time_us < next) {
+        next = inputs[input_arrived].time_us;
+    }
+    return next;
+}
+
+static void peripherals_update(void) {
+    sim_i2c_update();
+    sim_pio_update();
+    while (input_arrived < input_count && inputs[input_arrived].time_us <= sim_now_us) {
+        input_arrived++;
+        sim_event = true; // the usb interrupt
+    }
+}
+
+void sim_advance_to(uint64_t t) {
+    while (1) {
+        uint64_t next = peripherals_next_event();
+        bool is_edge = false;
+        if (next_edge < edge_count && edges[next_edge].time_us <= next) {
+            next = edges[next_edge].time_us;
+            is_edge = true;
+        }
+        if (next > t) {
+            break;
+        }
+        if (next > sim_now_us) {
+            sim_now_us = next;
+        }
+        if (is_edge) {
+            drive_input(edges[next_edge].gpio, edges[next_edge].level);
+            next_edge++;
+        } else {
+            peripherals_update();
+        }
+    }
+    if (t > sim_now_us) {
+        sim_now_us = t;
+    }
+    peripherals_update();
+
+    if (sim_now_us >= sim_end_us) {
+        exit(0); // the summary is printed by the atexit handler
+    }
+}
+
+uint64_t time_us_64(void) {
+    return sim_now_us;
+}
+
+void sleep_until(absolute_time_t target) {
+    sim_advance_to(to_us_since_boot(target));
+}
+
+void sleep_us(uint64_t us) {
+    sim_advance_to(sim_now_us + us);
+}
+
+void sleep_ms(uint32_t ms) {
+    sim_advance_to(sim_now_us + (uint64_t)ms * 1000);
+}
+
+void tight_loop_contents(void) {
+    // whatever is being waited for can only happen at the next event, so skip straight there
+    uint64_t next = peripherals_next_event();
+    if (next_edge < edge_count && edges[next_edge].time_us < next) {
+        next = edges[next_edge].time_us;
+    }
+    if (next <= sim_now_us || next > sim_now_us + 1000) {
+        next = sim_now_us + 1;
+    }
+    sim_advance_to(next);
+}
+
+// move time on to the next thing that could cause an interrupt, until one does or it gets to until.
+// returns true if it got to until
+static bool wait_for_event(uint64_t until) {
+    if (until > sim_end_us) {
+        until = sim_end_us; // nothing left to wake it up, but the simulation is over by then anyway
+    }
+    while (!sim_event && sim_now_us < until) {
+        uint64_t next = peripherals_next_event();
+        if (next_edge < edge_count && edges[next_edge].time_us < next) {
+            next = edges[next_edge].time_us;
+        }
+        sim_advance_to(next < until ? next : until);
+    }
+    bool timed_out = !sim_event;
+    sim_event = false;
+    wakeups++;
+    return timed_out;
+}
+
+void __wfe(void) {
+    wait_for_event(UINT64_MAX);
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp) {
+    return wait_for_event(to_us_since_boot(timeout_timestamp));
+}
+
+bool stdio_init_all(void) {
+    return true;
+}
+
+// RUN --------------------------------------------------------------------------------
+
+static struct timespec wall_start;
+
+FILE *sim_open_output(const char *name) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", sim_out_dir, name);
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "can't write %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    return f;
+}
+
+static void summary(void) {
+    struct timespec wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+    double simulated = sim_now_us / 1e6;
+
+    fflush(stdout);
+    if (outputs_log) {
+        fclose(outputs_log);
+    }
+    fprintf(stderr, "simulated %.1f s in %.2f s (%.0fx real time), %zu reed edges\n",
+            simulated, wall, wall > 0 ? simulated / wall : 0, next_edge);
+    fprintf(stderr, "woke up %llu times (%.1f a minute), interrupts held back by up to %llu us\n",
+            (unsigned long long)wakeups, simulated > 0 ? wakeups * 60 / simulated : 0,
+            (unsigned long long)max_irq_latency_us);
+    sim_pio_report(stderr);
+    sim_i2c_report(stderr);
+    sim_flash_report(stderr);
+}
+
+void sim_start(void) {
+    qsort(edges, edge_count, sizeof(sim_edge_t), compare_edges);
+
+    if (sim_out_dir) {
+        char frames_dir[512];
+        snprintf(frames_dir, sizeof(frames_dir), "%s/frames", sim_out_dir);
+        if ((mkdir(sim_out_dir, 0777) && errno != EEXIST) || (mkdir(frames_dir, 0777) && errno != EEXIST)) {
+            fprintf(stderr, "can't create %s: %s\n", frames_dir, strerror(errno));
+            exit(1);
+        }
+        outputs_log = sim_open_output("outputs.txt");
+        fprintf(outputs_log, "# time_us gpio_output_mask\n");
+
+        clock_gettime(CLOCK_MONOTONIC, &wall_start);
+        atexit(summary);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef _inc_sim
+#define _inc_sim
+
+#include <stdio.h>
+#include "pico.h"
+#include "hardware/dma.h"
+
+// the simulated clock in microseconds since boot. it only moves when the firmware sleeps or
+// busy-waits, so simulated time runs as fast as the PC can run the mainloop
+extern uint64_t sim_now_us;
+
+// move the simulated clock forward to t, delivering every reed edge and finishing every
+// peripheral transfer that falls due on the way (so interrupts fire at exactly the right time)
+void sim_advance_to(uint64_t t);
+
+// the simulation ends (exits) when the clock gets here
+extern uint64_t sim_end_us;
+
+// where the output files go, NULL for none
+extern const char *sim_out_dir;
+
+// open a file in the output directory
+FILE *sim_open_output(const char *name);
+
+// add a change of level on an input pin at the given time (can be added in any order before sim_start)
+void sim_add_edge(uint64_t time_us, uint gpio, bool level);
+
+// text typed on the USB serial port at the given time, for getchar_timeout_us. it arrives like an
+// interrupt, waking the firmware up (must be added in time order, before sim_start)
+void sim_add_input(uint64_t time_us, const char *text);
+
+// time of the last edge added
+uint64_t sim_last_edge_us(void);
+
+// write all the edges out as a trace file (see spedo_host.c for the format)
+void sim_write_edges(FILE *f);
+
+// call once everything is set up, before running any firmware code
+void sim_start(void);
+
+// peripheral models, called by sim.c as time moves on
+uint64_t sim_i2c_next_event(void); // when the next in-flight transfer finishes (UINT64_MAX if none)
+void sim_i2c_update(void);         // finish any transfers that are done by now
+void sim_i2c_report(FILE *f);      // totals for the end of run summary
+void sim_flash_report(FILE *f);
+uint64_t sim_pio_next_event(void); // when the next edge gets through the debounce window (UINT64_MAX if none)
+void sim_pio_update(void);         // push the edges that have by now
+void sim_pio_input(uint gpio, bool level);
+void sim_pio_report(FILE *f);
+
+// hand a dma channel reading from a PIO RX FIFO over to the PIO model, returns false if it isn't one
+bool sim_pio_dma_start(uint channel, const dma_channel_config *config, volatile void *write_addr, const volatile void *read_addr);
+
+// raise an interrupt (see hardware/irq.h). it is held back while interrupts are disabled, like the gpio ones
+void sim_raise_irq(uint num);
+
+// the flash chip starts out erased, these load and save its contents as a raw image
+void sim_flash_load(const char *path);
+void sim_flash_save(const char *path);
+
+#endif
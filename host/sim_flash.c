@@ -0,0 +1,97 @@
+// the flash chip for the simulator. it behaves like NOR flash: erasing sets whole sectors to 0xff,
+// programming can only clear bits, and both take as long as they typically do on the W25Q16 fitted
+// to a pico - with interrupts held off, as the SDK needs them to be while the flash is busy
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include "sim.h"
+
+#define SECTOR_ERASE_US 45000
+#define PAGE_PROGRAM_US 400
+
+uint8_t sim_flash[PICO_FLASH_SIZE_BYTES];
+
+static uint64_t sectors_erased = 0;
+static uint64_t pages_programmed = 0;
+static uint64_t flash_busy_us = 0;
+
+static void check_range(uint32_t flash_offs, size_t count, uint32_t align, const char *what) {
+    if (flash_offs % align || count % align || flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+        fprintf(stderr, "%s of %zu bytes at 0x%x is misaligned or off the end of flash\n", what, count, flash_offs);
+        exit(1);
+    }
+}
+
+// the chip is busy and nothing else can run from flash, so time passes with interrupts off
+static void busy(uint64_t us) {
+    uint32_t status = save_and_disable_interrupts();
+    flash_busy_us += us;
+    sim_advance_to(sim_now_us + us);
+    restore_interrupts(status);
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    check_range(flash_offs, count, FLASH_SECTOR_SIZE, "erase");
+    memset(&sim_flash[flash_offs], 0xff, count);
+    sectors_erased += count / FLASH_SECTOR_SIZE;
+    busy(count / FLASH_SECTOR_SIZE * SECTOR_ERASE_US);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    check_range(flash_offs, count, FLASH_PAGE_SIZE, "program");
+    for (size_t i = 0; i < count; i++) {
+        sim_flash[flash_offs + i] &= data[i];
+    }
+    pages_programmed += count / FLASH_PAGE_SIZE;
+    busy(count / FLASH_PAGE_SIZE * PAGE_PROGRAM_US);
+}
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms) {
+    (void)enter_exit_timeout_ms;
+    uint32_t status = save_and_disable_interrupts();
+    func(param);
+    restore_interrupts(status);
+    return PICO_OK;
+}
+
+void sim_flash_load(const char *path) {
+    memset(sim_flash, 0xff, sizeof(sim_flash));
+    if (!path) {
+        return;
+    }
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        if (errno == ENOENT) {
+            return; // starts out blank, and gets saved there at the end
+        }
+        fprintf(stderr, "can't open flash image %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    size_t len = fread(sim_flash, 1, sizeof(sim_flash), f);
+    fclose(f);
+    if (len != sizeof(sim_flash)) {
+        fprintf(stderr, "flash image %s is %zu bytes, expected %u\n", path, len, PICO_FLASH_SIZE_BYTES);
+        exit(1);
+    }
+}
+
+void sim_flash_save(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(sim_flash, 1, sizeof(sim_flash), f) != sizeof(sim_flash)) {
+        fprintf(stderr, "can't write flash image %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    fclose(f);
+}
+
+void sim_flash_report(FILE *f) {
+    fprintf(f, "flash: %llu sectors erased, %llu pages programmed, busy %.3f s\n",
+            (unsigned long long)sectors_erased, (unsigned long long)pages_programmed, flash_busy_us / 1e6);
+}
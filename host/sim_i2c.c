@@ -0,0 +1,222 @@
+// i2c and dma for the simulator. the only thing on the bus is the OLED model, and transfers take as
+// long as they would on a real bus at the configured baudrate. dma from a PIO is handed over to sim_pio.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/dma.h"
+
+#include "sim.h"
+#include "ssd1306_model.h"
+
+static i2c_hw_t i2c_regs[2] = {
+    { .status = I2C_IC_STATUS_TFE_BITS | I2C_IC_STATUS_TFNF_BITS },
+    { .status = I2C_IC_STATUS_TFE_BITS | I2C_IC_STATUS_TFNF_BITS },
+};
+static uint i2c_baud[2] = { 100000, 100000 };
+
+i2c_inst_t i2c0_inst = { .hw = &i2c_regs[0] };
+i2c_inst_t i2c1_inst = { .hw = &i2c_regs[1] };
+
+static uint64_t bytes_sent = 0;
+static uint64_t transactions = 0;
+static uint64_t bus_busy_us = 0;
+static unsigned frames_dumped = 0;
+static uint64_t oled_on_us = 0;      // when the panel was first switched on
+static uint64_t first_frame_us = 0;  // and when it first showed anything
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    i2c_baud[i2c_get_index(i2c)] = baudrate;
+    return baudrate;
+}
+
+// start condition, address byte and data bytes (each 8 bits + ack), stop condition
+static uint64_t bus_time_us(i2c_inst_t *i2c, size_t len) {
+    uint64_t bits = 1 + (1 + len) * 9 + 1;
+    return (bits * 1000000 + i2c_baud[i2c_get_index(i2c)] - 1) / i2c_baud[i2c_get_index(i2c)];
+}
+
+// returns false if nothing acknowledged the address. the panel answers on whichever bus it is asked on
+static bool transaction(uint8_t addr, const uint8_t *src, size_t len) {
+    transactions++;
+    bytes_sent += 1 + len;
+    if (addr != SSD1306_MODEL_ADDRESS) {
+        return false;
+    }
+    ssd1306_model_write(src, len);
+    return true;
+}
+
+// called whenever a transaction has finished going out
+static void dump_frame(void) {
+    if (!oled_on_us && ssd1306_model_on()) {
+        oled_on_us = sim_now_us;
+    }
+    if (!first_frame_us && ssd1306_model_lit()) {
+        first_frame_us = sim_now_us;
+    }
+    if (!ssd1306_model_changed() || !sim_out_dir) {
+        return;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "frames/frame_%06u.pbm", frames_dumped++);
+    FILE *f = sim_open_output(name);
+    ssd1306_model_dump_pbm(f, sim_now_us);
+    fclose(f);
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    (void)nostop;
+    uint64_t duration = bus_time_us(i2c, len);
+    bus_busy_us += duration;
+    bool acked = transaction(addr, src, len);
+    sim_advance_to(sim_now_us + duration);
+    if (!acked) {
+        return PICO_ERROR_GENERIC;
+    }
+    dump_frame();
+    return (int)len;
+}
+
+// DMA --------------------------------------------------------------------------------
+
+typedef struct {
+    bool claimed;
+    dma_channel_config config;
+    volatile void *write_addr;
+    const volatile void *read_addr;
+    uint64_t busy_until; // 0 when idle
+    i2c_inst_t *i2c;     // set while feeding an i2c tx fifo
+} sim_dma_channel_t;
+
+static sim_dma_channel_t channels[NUM_DMA_CHANNELS];
+static dma_channel_hw_t channel_regs[NUM_DMA_CHANNELS];
+
+dma_channel_hw_t *dma_channel_hw_addr(uint channel) {
+    return &channel_regs[channel];
+}
+
+int dma_claim_unused_channel(bool required) {
+    for (int ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        if (!channels[ch].claimed) {
+            channels[ch].claimed = true;
+            return ch;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "no dma channels left\n");
+        exit(1);
+    }
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel) {
+    channels[channel].claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    (void)channel;
+    dma_channel_config c = {
+        .size = DMA_SIZE_32,
+        .read_increment = true,
+        .write_increment = false,
+        .dreq = 0x3f, // unpaced
+    };
+    return c;
+}
+
+static i2c_inst_t *i2c_for_data_cmd(volatile void *addr) {
+    if (addr == &i2c_regs[0].data_cmd) {
+        return i2c0;
+    }
+    if (addr == &i2c_regs[1].data_cmd) {
+        return i2c1;
+    }
+    return NULL;
+}
+
+static void start_transfer(uint channel, uint32_t count) {
+    sim_dma_channel_t *ch = &channels[channel];
+    channel_regs[channel].transfer_count = count;
+    if (sim_pio_dma_start(channel, &ch->config, ch->write_addr, ch->read_addr)) {
+        return;
+    }
+    i2c_inst_t *i2c = i2c_for_data_cmd(ch->write_addr);
+    if (!i2c || ch->config.size != DMA_SIZE_16 || !count) {
+        fprintf(stderr, "simulator only supports 16 bit dma into an i2c data_cmd register, or out of a PIO\n");
+        exit(1);
+    }
+
+    // split the stream of data_cmd words into transactions at each stop bit, the display model
+    // sees them straight away but the channel stays busy for as long as they'd take on the bus
+    const uint16_t *words = (const uint16_t *)ch->read_addr;
+    uint8_t *bytes = malloc(count);
+    size_t len = 0;
+    uint64_t duration = 0;
+    bool acked = true;
+    for (uint32_t i = 0; i < count; i++) {
+        bytes[len++] = (uint8_t)words[i];
+        if ((words[i] & I2C_IC_DATA_CMD_STOP_BITS) || i == count - 1) {
+            acked &= transaction((uint8_t)i2c->hw->tar, bytes, len);
+            duration += bus_time_us(i2c, len);
+            len = 0;
+        }
+    }
+    free(bytes);
+
+    if (!acked) {
+        i2c->hw->raw_intr_stat |= I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+    }
+    bus_busy_us += duration;
+    ch->i2c = i2c;
+    ch->busy_until = sim_now_us + duration;
+    i2c->hw->status = I2C_IC_STATUS_MST_ACTIVITY_BITS | I2C_IC_STATUS_TFNF_BITS;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+    channels[channel].config = *config;
+    channels[channel].write_addr = write_addr;
+    channels[channel].read_addr = read_addr;
+    if (trigger) {
+        start_transfer(channel, transfer_count);
+    }
+}
+
+void dma_channel_transfer_from_buffer_now(uint channel, const volatile void *read_addr, uint32_t transfer_count) {
+    channels[channel].read_addr = read_addr;
+    start_transfer(channel, transfer_count);
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return channels[channel].busy_until != 0;
+}
+
+uint64_t sim_i2c_next_event(void) {
+    uint64_t next = UINT64_MAX;
+    for (int ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        if (channels[ch].busy_until && channels[ch].busy_until < next) {
+            next = channels[ch].busy_until;
+        }
+    }
+    return next;
+}
+
+void sim_i2c_update(void) {
+    for (int ch = 0; ch < NUM_DMA_CHANNELS; ch++) {
+        sim_dma_channel_t *c = &channels[ch];
+        if (c->busy_until && c->busy_until <= sim_now_us) {
+            c->busy_until = 0;
+            c->i2c->hw->status = I2C_IC_STATUS_TFE_BITS | I2C_IC_STATUS_TFNF_BITS;
+            dump_frame();
+        }
+    }
+}
+
+void sim_i2c_report(FILE *f) {
+    fprintf(f, "i2c: %llu transactions, %llu bytes, bus busy %.3f s; %u OLED frames dumped\n",
+            (unsigned long long)transactions, (unsigned long long)bytes_sent, bus_busy_us / 1e6, frames_dumped);
+    fprintf(f, "oled: switched on at %.2f ms, first frame at %.2f ms\n", oled_on_us / 1e3, first_frame_us / 1e3);
+}
@@ -0,0 +1,340 @@
+// the PIO for the simulator. it doesn't run PIO code - stepping a state machine at 32MHz would be far too
+// slow - so it models what spedo's two programs do instead:
+// - reed_capture.pio: the same ticks, debounce window and timestamps, and the same words DMA'd out of the
+//   RX FIFO, and each state machine raising its own interrupt flag. it only does anything when the pin
+//   changes or a debounce window ends
+// - sevenseg_mux.pio: the pins follow the frame the DMA goes round, as soon as it changes. a multiplexed
+//   display shows up as every digit's segments and select lines at once, and brightness isn't modelled
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+
+#include "sim.h"
+#include "reed_capture.pio.h"
+#include "sevenseg_mux.pio.h"
+
+// every path through reed_capture.pio takes 4 cycles to decrement X once
+#define CYCLES_PER_TICK 4
+
+pio_hw_t sim_pio_hw[NUM_PIOS];
+
+typedef enum {
+    SM_OPEN,    // waiting for the pin to go low
+    SM_CLOSING, // it went low, waiting for the debounce window to end
+    SM_CLOSED,
+    SM_OPENING,
+} sm_state_t;
+
+typedef enum {
+    PROGRAM_NONE,
+    PROGRAM_REED_CAPTURE,
+    PROGRAM_SEVENSEG_MUX,
+} sim_program_t;
+
+typedef struct {
+    bool claimed;
+    bool enabled;
+    sim_program_t program;
+    pio_sm_config config;
+    bool have_window; // the program starts with a blocking pull
+    uint32_t window;  // Y, in ticks
+    uint64_t start_us;
+    sm_state_t state;
+    uint64_t edge_tick;  // when the pin changed
+    uint32_t edge_x;     // and what X was then
+    int dma_channel;     // reading the RX FIFO, -1 if nothing is
+    uintptr_t ring_base; // where the DMA writes, wrapping within 2^ring_bits bytes
+    uint32_t ring_bits;
+    uint32_t ring_offset;
+    uint32_t pins;       // sevenseg_mux: what it is showing
+} sim_sm_t;
+
+static sim_sm_t sms[NUM_PIOS][NUM_PIO_STATE_MACHINES];
+static uint8_t used_instructions[NUM_PIOS];
+static sim_program_t programs[NUM_PIOS][PIO_INSTRUCTION_COUNT]; // which program starts at each offset
+static uint32_t irq0_sources[NUM_PIOS];
+static uint32_t irq_flags[NUM_PIOS];
+
+static uint64_t pushed = 0;
+static uint64_t bounces = 0;
+static uint64_t lost = 0;
+static bool capturing = false; // a reed_capture state machine has been started
+
+uint pio_add_program(PIO pio, const pio_program_t *program) {
+    uint i = pio_get_index(pio);
+    if (used_instructions[i] + program->length > PIO_INSTRUCTION_COUNT) {
+        fprintf(stderr, "PIO program doesn't fit (%d instructions)\n", program->length);
+        exit(1);
+    }
+    uint offset = used_instructions[i];
+    used_instructions[i] += program->length;
+    // the stand-in headers don't have the real instructions, so the programs are told apart by length
+    if (program->length == reed_capture_program.length) {
+        programs[i][offset] = PROGRAM_REED_CAPTURE;
+    } else if (program->length == sevenseg_mux_program.length) {
+        programs[i][offset] = PROGRAM_SEVENSEG_MUX;
+    } else {
+        fprintf(stderr, "the simulator doesn't model this PIO program (%d instructions)\n", program->length);
+        exit(1);
+    }
+    return offset;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required) {
+    for (int sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (!sms[pio_get_index(pio)][sm].claimed) {
+            sms[pio_get_index(pio)][sm].claimed = true;
+            sms[pio_get_index(pio)][sm].dma_channel = -1;
+            return sm;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "no PIO state machines left\n");
+        exit(1);
+    }
+    return -1;
+}
+
+void pio_gpio_init(PIO pio, uint pin) {
+    (void)pio;
+    (void)pin;
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out) {
+    (void)pio;
+    (void)sm;
+    for (uint pin = pin_base; pin < pin_base + pin_count; pin++) {
+        gpio_set_dir(pin, is_out);
+    }
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) {
+    sim_sm_t *s = &sms[pio_get_index(pio)][sm];
+    s->program = programs[pio_get_index(pio)][initial_pc];
+    s->config = *config;
+    s->enabled = false;
+    s->have_window = false;
+}
+
+static uint64_t ticks_at(const sim_sm_t *s, uint64_t t_us) {
+    uint64_t mhz = clock_get_hz(clk_sys) / 1000000;
+    return (t_us - s->start_us) * mhz * 256 / ((uint64_t)s->config.clkdiv_256 * CYCLES_PER_TICK);
+}
+
+// when a tick starts, rounded up to the next us
+static uint64_t us_at(const sim_sm_t *s, uint64_t tick) {
+    uint64_t mhz = clock_get_hz(clk_sys) / 1000000;
+    uint64_t den = mhz * 256;
+    return s->start_us + (tick * s->config.clkdiv_256 * CYCLES_PER_TICK + den - 1) / den;
+}
+
+// X starts at 0xffffffff and goes down once a tick
+static uint32_t x_at(uint64_t tick) {
+    return 0xffffffffu - (uint32_t)tick;
+}
+
+// the pin changing, the same as the program's jmp pin seeing it on the next tick
+static void pin_changed(sim_sm_t *s, bool level) {
+    uint64_t tick = ticks_at(s, sim_now_us);
+    switch (s->state) {
+    case SM_OPEN:
+    case SM_CLOSED:
+        if (level == (s->state == SM_CLOSED)) {
+            s->state = s->state == SM_OPEN ? SM_CLOSING : SM_OPENING;
+            s->edge_tick = tick;
+            s->edge_x = x_at(tick);
+        }
+        break;
+    case SM_CLOSING:
+    case SM_OPENING:
+        if (level == (s->state == SM_CLOSING)) {
+            // bounced back before the window was up
+            s->state = s->state == SM_CLOSING ? SM_OPEN : SM_CLOSED;
+            bounces++;
+        }
+        break;
+    }
+}
+
+// the tick the edge gets pushed on, if the pin holds until then: the one it was seen on, one more to
+// load Y, then the window (to within a tick of the real program, which differs slightly between
+// closing and opening)
+static uint64_t push_tick(const sim_sm_t *s) {
+    return s->edge_tick + 2 + s->window;
+}
+
+static void push(uint pio, uint sm, sim_sm_t *s, uint32_t word) {
+    pushed++;
+    if (s->dma_channel >= 0 && dma_channel_hw_addr(s->dma_channel)->transfer_count) {
+        *(volatile uint32_t *)(s->ring_base + s->ring_offset) = word;
+        s->ring_offset = (s->ring_offset + 4) & ((1u << s->ring_bits) - 1);
+        dma_channel_hw_addr(s->dma_channel)->transfer_count--;
+    } else {
+        lost++; // nothing takes it out of the RX FIFO, so with push noblock it soon gets thrown away
+    }
+    // irq nowait 0 rel: the state machine's own flag
+    irq_flags[pio] |= 1u << sm;
+    if (irq0_sources[pio] & (1u << (pis_interrupt0 + sm))) {
+        sim_raise_irq(pio ? PIO1_IRQ_0 : PIO0_IRQ_0);
+    }
+}
+
+static void start(sim_sm_t *s) {
+    if (s->program != PROGRAM_REED_CAPTURE) {
+        return;
+    }
+    s->start_us = sim_now_us;
+    s->state = SM_OPEN;
+    capturing = true;
+    if (!gpio_get(s->config.jmp_pin)) {
+        pin_changed(s, false);
+    }
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    sim_sm_t *s = &sms[pio_get_index(pio)][sm];
+    s->enabled = enabled;
+    if (enabled && s->have_window) {
+        start(s);
+    }
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data) {
+    sim_sm_t *s = &sms[pio_get_index(pio)][sm];
+    if (s->program != PROGRAM_REED_CAPTURE || s->have_window) {
+        return; // the program only ever pulls once
+    }
+    s->have_window = true;
+    s->window = data;
+    if (s->enabled) {
+        start(s);
+    }
+}
+
+void pio_set_irq0_source_enabled(PIO pio, enum pio_interrupt_source source, bool enabled) {
+    if (enabled) {
+        irq0_sources[pio_get_index(pio)] |= 1u << source;
+    } else {
+        irq0_sources[pio_get_index(pio)] &= ~(1u << source);
+    }
+}
+
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num) {
+    return irq_flags[pio_get_index(pio)] & (1u << pio_interrupt_num);
+}
+
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num) {
+    irq_flags[pio_get_index(pio)] &= ~(1u << pio_interrupt_num);
+}
+
+bool sim_pio_dma_start(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                       const volatile void *read_addr) {
+    for (uint pio = 0; pio < NUM_PIOS; pio++) {
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+            if (write_addr == &sim_pio_hw[pio].txf[sm]) {
+                if (config->size != DMA_SIZE_32 || !config->read_increment || config->write_increment ||
+                    config->ring_on_write || config->dreq != pio_get_dreq(&sim_pio_hw[pio], sm, true)) {
+                    fprintf(stderr, "simulator only supports 32 bit dma into a PIO TX FIFO from a ring\n");
+                    exit(1);
+                }
+                sim_sm_t *s = &sms[pio][sm];
+                s->dma_channel = channel;
+                s->ring_bits = config->ring_size_bits;
+                s->ring_base = (uintptr_t)read_addr & ~(uintptr_t)((1u << s->ring_bits) - 1);
+                return true;
+            }
+            if (read_addr != &sim_pio_hw[pio].rxf[sm]) {
+                continue;
+            }
+            if (config->size != DMA_SIZE_32 || config->read_increment || !config->write_increment ||
+                !config->ring_on_write || config->dreq != pio_get_dreq(&sim_pio_hw[pio], sm, false)) {
+                fprintf(stderr, "simulator only supports 32 bit dma from a PIO RX FIFO into a ring\n");
+                exit(1);
+            }
+            sim_sm_t *s = &sms[pio][sm];
+            s->dma_channel = channel;
+            s->ring_bits = config->ring_size_bits;
+            s->ring_base = (uintptr_t)write_addr & ~(uintptr_t)((1u << s->ring_bits) - 1);
+            s->ring_offset = (uintptr_t)write_addr - s->ring_base;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t sim_pio_next_event(void) {
+    uint64_t next = UINT64_MAX;
+    for (uint pio = 0; pio < NUM_PIOS; pio++) {
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+            sim_sm_t *s = &sms[pio][sm];
+            if (s->program == PROGRAM_REED_CAPTURE && s->enabled && s->have_window &&
+                (s->state == SM_CLOSING || s->state == SM_OPENING)) {
+                uint64_t t = us_at(s, push_tick(s));
+                if (t < next) {
+                    next = t;
+                }
+            }
+        }
+    }
+    return next;
+}
+
+// the pins lit in any of the words in the frame
+static void refresh_display(sim_sm_t *s) {
+    if (s->dma_channel < 0) {
+        return;
+    }
+    uint32_t pins = 0;
+    for (uint32_t offset = 0; offset < 1u << s->ring_bits; offset += 4) {
+        pins |= *(volatile uint32_t *)(s->ring_base + offset) & 0xffff;
+    }
+    pins &= (1u << s->config.out_count) - 1;
+    if (pins != s->pins) {
+        s->pins = pins;
+        gpio_put_masked(((1u << s->config.out_count) - 1) << s->config.out_base, pins << s->config.out_base);
+    }
+}
+
+void sim_pio_update(void) {
+    for (uint pio = 0; pio < NUM_PIOS; pio++) {
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+            sim_sm_t *s = &sms[pio][sm];
+            if (s->program == PROGRAM_SEVENSEG_MUX && s->enabled) {
+                refresh_display(s);
+                continue;
+            }
+            if (!s->enabled || !s->have_window || (s->state != SM_CLOSING && s->state != SM_OPENING)) {
+                continue;
+            }
+            if (push_tick(s) <= ticks_at(s, sim_now_us)) {
+                s->state = s->state == SM_CLOSING ? SM_CLOSED : SM_OPEN;
+                push(pio, sm, s, s->edge_x);
+            }
+        }
+    }
+}
+
+void sim_pio_input(uint gpio, bool level) {
+    sim_pio_update(); // anything that got through its window before the pin changed again
+    for (uint pio = 0; pio < NUM_PIOS; pio++) {
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+            sim_sm_t *s = &sms[pio][sm];
+            if (s->program == PROGRAM_REED_CAPTURE && s->enabled && s->have_window && s->config.jmp_pin == gpio) {
+                pin_changed(s, level);
+            }
+        }
+    }
+}
+
+void sim_pio_report(FILE *f) {
+    if (!capturing) {
+        return;
+    }
+    fprintf(f, "pio: %llu edges pushed, %llu bounces filtered out, %llu lost\n",
+            (unsigned long long)pushed, (unsigned long long)bounces, (unsigned long long)lost);
+}
@@ -0,0 +1,312 @@
+// accuracy harness: rides made up wheel profiles, where the truth is known exactly, through the firmware's
+// own edge filter and ride stats, and measures how far what spedo reports is from it:
+//   speed     each revolution's speed against the true speed as the magnet went past (km/h)
+//   distance  at the end of the ride, against how far the wheel really went
+//   moving    moving time at the end, against how long the wheel was really turning
+// each profile has limits on those, and it exits with 1 if any of them is over (so a change to the
+// filtering that makes things worse gets noticed). --csv FILE writes every revolution's speed error out,
+// for looking at the whole distribution
+//
+// the reed switch is closed for MAGNET_CLOSED_MM of the wheel's travel each time the magnet goes past. the
+// jittery profile also moves each closing about a bit and makes the contacts bounce as they close and open,
+// and every edge goes to the filter (as with REED_PIO 0 - the PIO would have debounced some of them).
+// profiles can have several magnets on the wheel (otherwise it is WHEEL_MAGNETS, equally spaced), not quite
+// where they should be, for the filter to learn the spacing of
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "pico/stdlib.h"
+
+#include "edge_filter.h"
+#include "ride_stats.h"
+#include "speed.h"
+
+#define MAGNET_CLOSED_MM 20
+#define MAGNET_MIN_CLOSED_US 500
+
+// the truth is worked out in steps this long, closings are interpolated in between
+#define STEP_US 20
+
+// jittery contacts: closings up to this far either side of where they should be, and up to
+// BOUNCES extra open/close pairs, each up to BOUNCE_US long, at either end
+#define JITTER_US 300
+#define BOUNCES 3
+#define BOUNCE_US 150
+
+typedef struct {
+    double from_kmh;
+    double to_kmh; // speed changes steadily from one to the other
+    double secs;
+} segment_t;
+
+typedef struct {
+    double speed_p95_kmh;
+    double speed_max_kmh;
+    double dist_pct;
+    double moving_s;
+} limits_t;
+
+typedef struct {
+    const char *name;
+    const segment_t *segments;
+    bool jitter;
+    limits_t limits;
+    uint magnets;            // 0 for WHEEL_MAGNETS
+    const double *misplaced; // how far each magnet is from where it should be (mm), or NULL
+} profile_t;
+
+#define END {0, 0, 0}
+
+static const segment_t constant[] = {{0, 0, 5}, {25, 25, 300}, {0, 0, 15}, END};
+static const segment_t accelerating[] = {{0, 0, 5}, {5, 45, 120}, {45, 45, 30}, {0, 0, 15}, END};
+static const segment_t sprint[] = {
+    {0, 0, 5}, {20, 20, 60}, {20, 55, 8}, {55, 55, 15}, {55, 20, 10}, {20, 20, 60}, {0, 0, 15}, END,
+};
+static const segment_t stop_start[] = {
+    {0, 0, 5},
+    {0, 25, 10}, {25, 25, 40}, {25, 0, 6}, {0, 0, 20},
+    {0, 25, 10}, {25, 25, 40}, {25, 0, 6}, {0, 0, 20},
+    {0, 25, 10}, {25, 25, 40}, {25, 0, 6}, {0, 0, 20},
+    {0, 25, 10}, {25, 25, 40}, {25, 0, 6}, {0, 0, 20},
+    {0, 25, 10}, {25, 25, 40}, {25, 0, 6}, {0, 0, 20},
+    END,
+};
+static const segment_t jittery[] = {{0, 0, 5}, {30, 30, 180}, {30, 10, 20}, {10, 40, 60}, {0, 0, 15}, END};
+static const segment_t walking[] = {
+    {0, 0, 5}, {0, 5, 10}, {5, 5, 60}, {5, 0, 4}, {0, 0, 10}, {0, 15, 10}, {15, 15, 60}, {15, 0, 5}, {0, 0, 15}, END,
+};
+static const double misplaced_4[] = {0, 25, -15, 10};
+
+// the limits are a bit over what it does now. most of the speed error is the filter lagging behind hard
+// acceleration. the distance is short by a couple of revolutions every time it sets off (the first one
+// isn't counted, as there is nothing to time it from, and the wheel was part way round), and the moving
+// time by the slow first revolution and last part of one every time it stops. walking_4 is mostly the
+// filter lagging as it sets off and slows down too - on one magnet the same ride is out by over 3 km/h
+static const profile_t profiles[] = {
+    {.name = "constant", .segments = constant, .limits = {0.05, 0.05, 0.25, 1}},
+    {.name = "accelerating", .segments = accelerating, .limits = {0.15, 0.6, 0.35, 2}},
+    {.name = "sprint", .segments = sprint, .limits = {0.7, 2.2, 0.4, 1}},
+    {.name = "stop_start", .segments = stop_start, .limits = {2.2, 4.0, 0.8, 17}},
+    {.name = "jittery", .segments = jittery, .jitter = true, .limits = {0.25, 1.2, 0.25, 1}},
+    {.name = "walking_4", .segments = walking, .limits = {0.35, 1.4, 0.4, 7}, .magnets = 4, .misplaced = misplaced_4},
+};
+
+#define PROFILES (sizeof(profiles) / sizeof(profiles[0]))
+
+// a fixed seed, so every run is the same
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// -range to range
+static int32_t rng_range(int32_t range) {
+    return (int32_t)(rng() % (2 * range + 1)) - range;
+}
+
+typedef struct {
+    const profile_t *profile;
+    edge_filter_t filter;
+    ride_stats_t ride;
+    bool moving;          // for spotting the wheel stopping, like the firmware's stop task
+
+    double true_kmh;      // as of the closing being fed in
+    double *errors;       // signed speed error of each revolution, km/h
+    size_t count;
+    size_t cap;
+    FILE *csv;
+} run_t;
+
+static void push(run_t *r, uint64_t time_us, bool closed) {
+    // the firmware's stop task would have gone off before this edge
+    if (r->moving && time_us > edge_filter_due_us(&r->filter, EDGE_FILTER_STOPPED_AFTER_US)) {
+        edge_filter_stop(&r->filter);
+        r->moving = false;
+    }
+    reed_edge_t edge = {.time_us = time_us, .closed = closed};
+    edge_filter_event_t ev = edge_filter_push(&r->filter, &edge);
+    if (ev == EDGE_FILTER_NONE) {
+        return;
+    }
+    r->moving = true;
+    if (ev != EDGE_FILTER_REV) {
+        return;
+    }
+    ride_stats_revolution(&r->ride, r->filter.arc_q16, r->filter.interval_us, r->filter.speed);
+
+    double error = r->filter.speed / (double)(1 << SPEED_FRAC_BITS) - r->true_kmh;
+    if (r->count == r->cap) {
+        r->cap = r->cap ? r->cap * 2 : 1024;
+        r->errors = realloc(r->errors, r->cap * sizeof(double));
+        if (!r->errors) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    r->errors[r->count++] = error;
+    if (r->csv) {
+        fprintf(r->csv, "%s,%llu,%.3f,%.3f\n", r->profile->name, (unsigned long long)time_us, r->true_kmh, error);
+    }
+}
+
+// the magnet arriving at t_us, closing the switch until it has gone MAGNET_CLOSED_MM further
+static void magnet(run_t *r, uint64_t t_us, double kmh) {
+    double mm_per_us = kmh / 3600.0;
+    uint64_t closed_us = (uint64_t)(MAGNET_CLOSED_MM / mm_per_us);
+    if (closed_us < MAGNET_MIN_CLOSED_US) {
+        closed_us = MAGNET_MIN_CLOSED_US;
+    }
+    r->true_kmh = kmh;
+    if (!r->profile->jitter) {
+        push(r, t_us, true);
+        push(r, t_us + closed_us, false);
+        return;
+    }
+
+    uint64_t close = t_us + rng_range(JITTER_US);
+    uint64_t open = close + closed_us;
+    uint64_t t = close;
+    push(r, t, true);
+    for (int i = rng() % (BOUNCES + 1); i > 0; i--) {
+        t += 1 + rng() % BOUNCE_US;
+        push(r, t, false);
+        t += 1 + rng() % BOUNCE_US;
+        push(r, t, true);
+    }
+    t = open;
+    push(r, t, false);
+    for (int i = rng() % (BOUNCES + 1); i > 0; i--) {
+        t += 1 + rng() % BOUNCE_US;
+        push(r, t, true);
+        t += 1 + rng() % BOUNCE_US;
+        push(r, t, false);
+    }
+}
+
+static int compare_abs(const void *a, const void *b) {
+    double x = fabs(*(const double *)a);
+    double y = fabs(*(const double *)b);
+    return x < y ? -1 : x > y;
+}
+
+// the p'th percentile of the errors, by size
+static double percentile(const double *sorted, size_t n, double p) {
+    if (!n) {
+        return 0;
+    }
+    size_t i = (size_t)(p / 100 * (n - 1) + 0.5);
+    return fabs(sorted[i]);
+}
+
+static bool check(const char *profile, const char *what, double value, double limit) {
+    if (value <= limit) {
+        return true;
+    }
+    printf("FAIL %s: %s %.3f is over the limit of %.3f\n", profile, what, value, limit);
+    return false;
+}
+
+static bool run_profile(const profile_t *profile, FILE *csv) {
+    edge_filter_config_t config = EDGE_FILTER_CONFIG_SPEDO;
+    if (profile->magnets) {
+        config.magnets = profile->magnets;
+    }
+    run_t r = {.profile = profile, .csv = csv};
+    edge_filter_init(&r.filter, &config);
+
+    // how far each magnet is round from the one before
+    uint magnets = r.filter.config.magnets;
+    double gap_mm[EDGE_FILTER_MAX_MAGNETS];
+    for (uint i = 0; i < magnets; i++) {
+        double prev = profile->misplaced ? profile->misplaced[(i + magnets - 1) % magnets] : 0;
+        double here = profile->misplaced ? profile->misplaced[i] : 0;
+        gap_mm[i] = WHEEL_CIRCUMFERENCE_MM / (double)magnets + here - prev;
+    }
+    ride_stats_init(&r.ride);
+    rng_state = 1;
+
+    // step through the profile, noting when each magnet goes past
+    double pos_mm = 0;         // how far round the wheel is from the last magnet
+    uint next = 0;             // the one it is coming up to
+    double true_dist_mm = 0;
+    double true_moving_s = 0;
+    uint64_t t = 0;
+    for (const segment_t *seg = profile->segments; seg->secs > 0; seg++) {
+        uint64_t steps = (uint64_t)(seg->secs * 1e6 / STEP_US);
+        for (uint64_t i = 0; i < steps; i++, t += STEP_US) {
+            double kmh = seg->from_kmh + (seg->to_kmh - seg->from_kmh) * (i + 0.5) / steps;
+            double step_mm = kmh / 3600.0 * STEP_US;
+            if (step_mm <= 0) {
+                continue;
+            }
+            true_dist_mm += step_mm;
+            true_moving_s += STEP_US / 1e6;
+            if (pos_mm + step_mm >= gap_mm[next]) {
+                double frac = (gap_mm[next] - pos_mm) / step_mm;
+                magnet(&r, t + (uint64_t)(frac * STEP_US), kmh);
+                pos_mm -= gap_mm[next];
+                next = (next + 1) % magnets;
+            }
+            pos_mm += step_mm;
+        }
+    }
+
+    qsort(r.errors, r.count, sizeof(double), compare_abs);
+    double mean = 0;
+    for (size_t i = 0; i < r.count; i++) {
+        mean += r.errors[i];
+    }
+    mean = r.count ? mean / r.count : 0;
+    double p50 = percentile(r.errors, r.count, 50);
+    double p95 = percentile(r.errors, r.count, 95);
+    double max = percentile(r.errors, r.count, 100);
+    double dist_err_m = (r.ride.dist_mm - true_dist_mm) / 1000;
+    double dist_pct = fabs(dist_err_m) * 100000 / true_dist_mm;
+    double moving_err_s = r.ride.moving_us / 1e6 - true_moving_s;
+
+    printf("%-13s %6zu %+7.3f %7.3f %7.3f %7.3f | %9.1f %+8.2f %6.3f%% | %7.1f %+7.2f\n", profile->name, r.count,
+           mean, p50, p95, max, true_dist_mm / 1000, dist_err_m, dist_pct, true_moving_s, moving_err_s);
+    free(r.errors);
+
+    const limits_t *l = &profile->limits;
+    bool ok = check(profile->name, "speed p95 error (km/h)", p95, l->speed_p95_kmh);
+    ok &= check(profile->name, "speed max error (km/h)", max, l->speed_max_kmh);
+    ok &= check(profile->name, "distance error (%)", dist_pct, l->dist_pct);
+    ok &= check(profile->name, "moving time error (s)", fabs(moving_err_s), l->moving_s);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    FILE *csv = NULL;
+    if (argc == 3 && !strcmp(argv[1], "--csv")) {
+        if (!(csv = fopen(argv[2], "w"))) {
+            fprintf(stderr, "can't write %s: %s\n", argv[2], strerror(errno));
+            return 1;
+        }
+        fprintf(csv, "profile,time_us,true_kmh,error_kmh\n");
+    } else if (argc != 1) {
+        fprintf(stderr, "usage: %s [--csv FILE]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%-20s %-31s | %-26s | %s\n", "", "speed error (km/h)", "distance (m)", "moving time (s)");
+    printf("%-13s %6s %7s %7s %7s %7s | %9s %8s %7s | %7s %7s\n", "", "revs", "mean", "p50", "p95", "max",
+           "true", "error", "", "true", "error");
+    bool ok = true;
+    for (size_t i = 0; i < PROFILES; i++) {
+        ok &= run_profile(&profiles[i], csv);
+    }
+    if (csv) {
+        fclose(csv);
+    }
+    printf(ok ? "all within limits\n" : "accuracy has regressed\n");
+    return ok ? 0 : 1;
+}
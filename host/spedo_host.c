@@ -0,0 +1,255 @@
+// host simulator for spedo: runs the firmware's main() on a PC against a stubbed Pico SDK.
+//
+// the reed switch is driven from a trace of edges, either recorded (--trace) or made up from a
+// speed profile (--profile), and simulated time only moves when the firmware waits - so an hour
+// long ride replays in a few seconds. outputs (in --out, default sim_out/):
+//   outputs.txt  - timeline of the gpio outputs (7 segment display and led), one line per change
+//   frames/      - a PBM image of every frame sent to the OLED
+//   flash.bin    - the flash chip at the end, with the ride log in it (see ride_log_decode.c). it starts out
+//                  erased, or as the image given with --flash (which is then saved back there instead)
+// --cadence RPM:SECS[,RPM:SECS...] drives the cadence sensor on the cranks the same way, from the start.
+// the firmware's own printf log goes to stdout as usual, and a summary goes to stderr at the end.
+// --type SECS:TEXT types TEXT on the USB serial port at SECS, e.g. --type 60:i to dump the instrumentation
+// a minute in (see instr.h). it can be given more than once, in time order
+//
+// trace files have one edge per line: <time_us> <gpio> <level>, where level is the electrical
+// level of the pin (the reed switch pulls it low when closed). lines starting with # are ignored.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+
+#include "sim.h"
+#include "speed.h"
+
+// the firmware's main(), renamed when it is built for the host
+int spedo_main(void);
+
+// how much of the wheel's travel the reed switch stays closed for as the magnet goes past
+#define MAGNET_CLOSED_MM 20
+#define MAGNET_MIN_CLOSED_US 500
+
+// and how much of a turn of the cranks the cadence sensor's does
+#define CRANK_CLOSED_DEGREES 10
+
+static void load_trace(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "can't open trace %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    char line[128];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        unsigned long long time_us;
+        unsigned gpio;
+        int level;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "%llu %u %d", &time_us, &gpio, &level) != 3 || gpio >= NUM_BANK0_GPIOS) {
+            fprintf(stderr, "%s:%d: expected <time_us> <gpio> <level>\n", path, line_no);
+            exit(1);
+        }
+        sim_add_edge(time_us, gpio, level != 0);
+    }
+    fclose(f);
+}
+
+// profile is a comma separated list of <km/h>:<seconds> segments, e.g. 0:5,25:600,0:30
+// returns when the profile ends
+static uint64_t generate_trace(const char *profile, uint gpio) {
+    uint64_t t = 0;
+    double pos_mm = 0; // how far round the wheel is from the last magnet
+    double gap_mm = WHEEL_CIRCUMFERENCE_MM / (double)WHEEL_MAGNETS; // to the next one
+    const char *p = profile;
+    while (*p) {
+        double kmh, secs;
+        int used;
+        if (sscanf(p, "%lf:%lf%n", &kmh, &secs, &used) != 2 || kmh < 0 || secs < 0) {
+            fprintf(stderr, "bad profile segment '%s', expected <km/h>:<seconds>\n", p);
+            exit(1);
+        }
+        p += used;
+        if (*p == ',') {
+            p++;
+        }
+
+        uint64_t end = t + (uint64_t)(secs * 1e6);
+        if (kmh == 0) {
+            t = end; // wheel stopped where it was
+            continue;
+        }
+        double mm_per_us = kmh / 3600.0;
+        while (1) {
+            uint64_t to_magnet = (uint64_t)((gap_mm - pos_mm) / mm_per_us);
+            if (t + to_magnet >= end) {
+                pos_mm += (end - t) * mm_per_us;
+                t = end;
+                break;
+            }
+            t += to_magnet;
+            pos_mm = 0;
+            uint64_t closed_us = (uint64_t)(MAGNET_CLOSED_MM / mm_per_us);
+            if (closed_us < MAGNET_MIN_CLOSED_US) {
+                closed_us = MAGNET_MIN_CLOSED_US;
+            }
+            sim_add_edge(t, gpio, false);
+            sim_add_edge(t + closed_us, gpio, true);
+        }
+    }
+    return t;
+}
+
+// profile is a comma separated list of <rpm>:<seconds> segments for the cranks, e.g. 0:5,85:600
+// returns when the profile ends
+static uint64_t generate_cadence(const char *profile, uint gpio) {
+    uint64_t t = 0;
+    double turn = 0; // how far round the cranks are from the magnet, in turns
+    const char *p = profile;
+    while (*p) {
+        double rpm, secs;
+        int used;
+        if (sscanf(p, "%lf:%lf%n", &rpm, &secs, &used) != 2 || rpm < 0 || secs < 0) {
+            fprintf(stderr, "bad cadence segment '%s', expected <rpm>:<seconds>\n", p);
+            exit(1);
+        }
+        p += used;
+        if (*p == ',') {
+            p++;
+        }
+
+        uint64_t end = t + (uint64_t)(secs * 1e6);
+        if (rpm == 0) {
+            t = end; // not pedalling
+            continue;
+        }
+        double turns_per_us = rpm / 60e6;
+        while (1) {
+            uint64_t to_magnet = (uint64_t)((1 - turn) / turns_per_us);
+            if (t + to_magnet >= end) {
+                turn += (end - t) * turns_per_us;
+                t = end;
+                break;
+            }
+            t += to_magnet;
+            turn = 0;
+            uint64_t closed_us = (uint64_t)(CRANK_CLOSED_DEGREES / 360.0 / turns_per_us);
+            if (closed_us < MAGNET_MIN_CLOSED_US) {
+                closed_us = MAGNET_MIN_CLOSED_US;
+            }
+            sim_add_edge(t, gpio, false);
+            sim_add_edge(t + closed_us, gpio, true);
+        }
+    }
+    return t;
+}
+
+static char flash_path[512];
+
+static void save_flash(void) {
+    sim_flash_save(flash_path);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--trace FILE | --profile KMH:SECS[,KMH:SECS...]] [--reed-gpio N]\n"
+            "          [--cadence RPM:SECS[,RPM:SECS...]] [--cadence-gpio N]\n"
+            "          [--duration SECS] [--record FILE] [--flash FILE] [--out DIR] [--type SECS:TEXT]...\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *trace = NULL;
+    const char *profile = NULL;
+    const char *cadence = NULL;
+    const char *record = NULL;
+    const char *flash = NULL;
+    double duration = -1;
+    uint reed_gpio = 22;
+    uint cadence_gpio = 26;
+
+    sim_out_dir = "sim_out";
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        if (!strcmp(argv[i], "--trace")) {
+            trace = argv[++i];
+        } else if (!strcmp(argv[i], "--profile")) {
+            profile = argv[++i];
+        } else if (!strcmp(argv[i], "--reed-gpio")) {
+            reed_gpio = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--cadence")) {
+            cadence = argv[++i];
+        } else if (!strcmp(argv[i], "--cadence-gpio")) {
+            cadence_gpio = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--duration")) {
+            duration = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--record")) {
+            record = argv[++i];
+        } else if (!strcmp(argv[i], "--flash")) {
+            flash = argv[++i];
+        } else if (!strcmp(argv[i], "--out")) {
+            sim_out_dir = argv[++i];
+        } else if (!strcmp(argv[i], "--type")) {
+            double secs;
+            int used;
+            if (sscanf(argv[++i], "%lf:%n", &secs, &used) != 1 || secs < 0) {
+                usage(argv[0]);
+            }
+            sim_add_input((uint64_t)(secs * 1e6), argv[i] + used);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (trace && profile) {
+        usage(argv[0]);
+    }
+
+    uint64_t end = 0;
+    if (trace) {
+        load_trace(trace);
+    } else {
+        end = generate_trace(profile ? profile : "0:5,20:120,35:60,0:30", reed_gpio);
+    }
+    if (cadence) {
+        uint64_t cadence_end = generate_cadence(cadence, cadence_gpio);
+        if (cadence_end > end) {
+            end = cadence_end;
+        }
+    }
+    if (sim_last_edge_us() > end) {
+        end = sim_last_edge_us();
+    }
+    if (duration >= 0) {
+        sim_end_us = (uint64_t)(duration * 1e6);
+    } else {
+        sim_end_us = end + 15000000; // long enough after the last edge to see the speedometer give up
+    }
+    if (record) {
+        FILE *f = fopen(record, "w");
+        if (!f) {
+            fprintf(stderr, "can't write trace %s: %s\n", record, strerror(errno));
+            return 1;
+        }
+        sim_write_edges(f);
+        fclose(f);
+    }
+
+    if (flash) {
+        snprintf(flash_path, sizeof(flash_path), "%s", flash);
+    } else {
+        snprintf(flash_path, sizeof(flash_path), "%s/flash.bin", sim_out_dir);
+    }
+    sim_flash_load(flash);
+    sim_start();
+    atexit(save_flash); // after sim_start's, so this runs first
+
+    return spedo_main();
+}
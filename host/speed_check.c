@@ -0,0 +1,85 @@
+// checks speed.h's fixed point maths against the float expressions it replaced, for every wheel interval
+// from 5ms (~1600 km/h) to 10s (under 1 km/h), 10us apart:
+//   speed_from_interval_us  within 1/256 km/h of WHEEL_CIRCUMFERENCE*3600*1000/interval, and the whole km/h
+//                           it shows the same as (int) of that (give or take the double being a hair under
+//                           where it is a whole number, 2.231 not being exact in binary)
+//   speed_to_mph            within 1/256 mph of km/h*0.62
+//   speed_average           within 0.01 km/h of 3.6*(dist/moving time), for an hour at that speed (the mm
+//                           and whole seconds it works in lose a bit)
+// prints the worst error of each, and every interval that is out, then exits with 1 if any were
+
+#include <stdio.h>
+#include <math.h>
+
+#include "pico/stdlib.h"
+
+#include "speed.h"
+
+#define FIRST_US 5000
+#define LAST_US 10000000
+#define STEP_US 10
+
+#define Q8_TOLERANCE (1.0 / (1 << SPEED_FRAC_BITS))
+#define AVERAGE_TOLERANCE 0.01
+#define MAX_REPORTED 20
+
+static double q8(speed_q8_t v) {
+    return v / (double)(1 << SPEED_FRAC_BITS);
+}
+
+static uint32_t failures = 0;
+
+static void fail(const char *what, uint32_t interval_us, double got, double want) {
+    if (failures++ < MAX_REPORTED) {
+        printf("FAIL %s at %lu us: %.6f, should be %.6f\n", what, (unsigned long)interval_us, got, want);
+    }
+}
+
+int main(void) {
+    double worst_speed = 0, worst_mph = 0, worst_average = 0;
+    uint32_t checked = 0;
+    for (uint32_t t = FIRST_US; t <= LAST_US; t += STEP_US, checked++) {
+        // how spedo.c used to do it
+        double kmh = (WHEEL_CIRCUMFERENCE*60*60*1000) / t;
+
+        speed_q8_t v = speed_from_interval_us(t);
+        double error = fabs(q8(v) - kmh);
+        worst_speed = error > worst_speed ? error : worst_speed;
+        if (error > Q8_TOLERANCE) {
+            fail("speed_from_interval_us", t, q8(v), kmh);
+        }
+        if (speed_kmh(v) != (int)(kmh + 1e-9)) {
+            fail("speed_kmh", t, speed_kmh(v), (int)(kmh + 1e-9));
+        }
+
+        double mph = q8(v) * 0.62;
+        error = fabs(q8(speed_to_mph(v)) - mph);
+        worst_mph = error > worst_mph ? error : worst_mph;
+        if (error > Q8_TOLERANCE) {
+            fail("speed_to_mph", t, q8(speed_to_mph(v)), mph);
+        }
+
+        // an hour at this speed, as far as it would have got
+        uint32_t secs = 3600;
+        double dist_m = kmh * 1000;
+        if (dist_m * 1000 >= UINT32_MAX) {
+            continue; // more than the uint32_t mm ride_stats keeps
+        }
+        double average = 3.6 * (dist_m / secs);
+        speed_q8_t fixed = speed_average((uint32_t)(dist_m * 1000), secs);
+        error = fabs(q8(fixed) - average);
+        worst_average = error > worst_average ? error : worst_average;
+        if (error > AVERAGE_TOLERANCE) {
+            fail("speed_average", t, q8(fixed), average);
+        }
+    }
+
+    printf("%lu intervals from %d us to %d us, worst errors: speed %.6f km/h, mph %.6f, average %.6f km/h\n",
+           (unsigned long)checked, FIRST_US, LAST_US, worst_speed, worst_mph, worst_average);
+    if (failures) {
+        printf("%lu out of tolerance\n", (unsigned long)failures);
+        return 1;
+    }
+    printf("all within tolerance\n");
+    return 0;
+}
@@ -0,0 +1,101 @@
+// checks what ssd1306_show_async sends, against the simulator's model of the panel: how many bytes go over
+// i2c for each kind of frame (not counting address bytes, like the bench), and that the panel ends up
+// showing exactly what is in the buffer:
+//   full      every byte changed, so every page in full: 8 * (1 + 6 + 1 + 128) = 1088
+//   digit     one 1x digit changed, a 5 column window in one page: 1 + 6 + 1 + 5 = 13
+//   unchanged nothing to send: 0
+//   invalidate after ssd1306_invalidate, with the panel's ram scribbled on, every page in full whatever gets
+//             drawn - here all 0xff, where the buffer was all 0 when it was invalidated
+// exits with 1 if any of them is wrong
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+#include "sim.h"
+#include "ssd1306.h"
+#include "ssd1306_model.h"
+
+#define FULL_FRAME_BYTES (SSD1306_MODEL_PAGES * (1 + 6 + 1 + SSD1306_MODEL_WIDTH))
+#define ANY_BYTES SIZE_MAX // for the frames that only set up the next one
+
+static ssd1306_t disp;
+static bool ok = true;
+
+// the panel's ram the same as the buffer
+static bool panel_matches(void) {
+    for (uint page = 0; page < SSD1306_MODEL_PAGES; page++) {
+        for (uint col = 0; col < SSD1306_MODEL_WIDTH; col++) {
+            if (ssd1306_model_ram(page, col) != disp.buffer[page * SSD1306_MODEL_WIDTH + col]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// send the buffer and wait for it to go out, checking the bytes it took
+static void show(const char *name, size_t expected_bytes) {
+    ssd1306_show(&disp);
+    bool matches = panel_matches();
+    printf("%-10s %5zu bytes%s\n", name, disp.txlen, matches ? "" : ", panel doesn't match the buffer");
+    if (expected_bytes != ANY_BYTES && disp.txlen != expected_bytes) {
+        printf("FAIL %s: sent %zu bytes, should be %zu\n", name, disp.txlen, expected_bytes);
+        ok = false;
+    }
+    if (!matches) {
+        printf("FAIL %s: the panel isn't showing the buffer\n", name);
+        ok = false;
+    }
+}
+
+// put garbage in the panel's ram behind the driver's back, like a reset or a transfer that didn't arrive
+static void scribble_on_panel(void) {
+    static const uint8_t window[] = {0x00, 0x21, 0, SSD1306_MODEL_WIDTH - 1, 0x22, 0, SSD1306_MODEL_PAGES - 1};
+    ssd1306_model_write(window, sizeof(window));
+    uint8_t data[1 + SSD1306_MODEL_WIDTH];
+    data[0] = 0x40;
+    for (uint page = 0; page < SSD1306_MODEL_PAGES; page++) {
+        for (uint col = 0; col < SSD1306_MODEL_WIDTH; col++) {
+            data[1 + col] = (uint8_t)(page * 37 + col * 11);
+        }
+        ssd1306_model_write(data, sizeof(data));
+    }
+}
+
+int main(void) {
+    sim_start();
+    i2c_init(i2c0, 400000);
+    if (!ssd1306_init(&disp, SSD1306_MODEL_WIDTH, SSD1306_MODEL_PAGES * 8, SSD1306_MODEL_ADDRESS, i2c0)) {
+        printf("FAIL couldn't set up the display\n");
+        return 1;
+    }
+    // the first frame also carries the configuration and switches the panel on
+    ssd1306_clear(&disp);
+    ssd1306_show(&disp);
+
+    memset(disp.buffer, 0xff, disp.bufsize);
+    show("full", FULL_FRAME_BYTES);
+
+    ssd1306_clear(&disp);
+    ssd1306_draw_string(&disp, 80, 56, 1, "15");
+    show("setup", ANY_BYTES);
+    ssd1306_clear(&disp);
+    ssd1306_draw_string(&disp, 80, 56, 1, "16");
+    show("digit", 1 + 6 + 1 + 5);
+
+    show("unchanged", 0);
+
+    ssd1306_clear(&disp);
+    show("setup", ANY_BYTES);
+    ssd1306_invalidate(&disp);
+    scribble_on_panel();
+    memset(disp.buffer, 0xff, disp.bufsize);
+    show("invalidate", FULL_FRAME_BYTES);
+
+    printf(ok ? "all as expected\n" : "ssd1306_show_async has regressed\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+#include <string.h>
+
+#include "ssd1306_model.h"
+
+static uint8_t ram[SSD1306_MODEL_PAGES][SSD1306_MODEL_WIDTH];
+static uint8_t col_start = 0, col_end = SSD1306_MODEL_WIDTH - 1, col = 0;
+static uint8_t page_start = 0, page_end = SSD1306_MODEL_PAGES - 1, page = 0;
+static bool display_on = false;
+static bool inverted = false;
+static bool entire_on = false;
+static uint8_t contrast = 0x7F; // the reset value
+static bool changed = false;
+
+// command being collected, with the arguments still to come
+static uint8_t cmd[3];
+static uint8_t cmd_len = 0;
+static uint8_t cmd_needed = 0;
+
+static uint8_t command_args(uint8_t c) {
+    switch (c) {
+    case 0x21: // SET_COL_ADDR
+    case 0x22: // SET_PAGE_ADDR
+        return 2;
+    case 0x20: // SET_MEM_ADDR
+    case 0x81: // SET_CONTRAST
+    case 0x8D: // SET_CHARGE_PUMP
+    case 0xA8: // SET_MUX_RATIO
+    case 0xD3: // SET_DISP_OFFSET
+    case 0xD5: // SET_DISP_CLK_DIV
+    case 0xD9: // SET_PRECHARGE
+    case 0xDA: // SET_COM_PIN_CFG
+    case 0xDB: // SET_VCOM_DESEL
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void run_command(void) {
+    switch (cmd[0]) {
+    case 0x21:
+        col_start = cmd[1] % SSD1306_MODEL_WIDTH;
+        col_end = cmd[2] % SSD1306_MODEL_WIDTH;
+        col = col_start;
+        break;
+    case 0x22:
+        page_start = cmd[1] % SSD1306_MODEL_PAGES;
+        page_end = cmd[2] % SSD1306_MODEL_PAGES;
+        page = page_start;
+        break;
+    case 0x81:
+        if (cmd[1] != contrast) {
+            contrast = cmd[1];
+            changed = true;
+        }
+        break;
+    case 0xA4:
+    case 0xA5:
+        entire_on = cmd[0] & 1;
+        changed = true;
+        break;
+    case 0xA6:
+    case 0xA7:
+        inverted = cmd[0] & 1;
+        changed = true;
+        break;
+    case 0xAE:
+    case 0xAF:
+        display_on = cmd[0] & 1;
+        changed = true;
+        break;
+    default:
+        break; // everything else only affects the analogue side of the panel (or how bright it is, above)
+    }
+}
+
+static void command_byte(uint8_t b) {
+    if (cmd_len == 0) {
+        cmd_needed = command_args(b);
+    }
+    cmd[cmd_len++] = b;
+    if (cmd_len > cmd_needed) {
+        run_command();
+        cmd_len = 0;
+    }
+}
+
+// horizontal addressing mode, wrapping within the column and page window
+static void data_byte(uint8_t b) {
+    if (ram[page][col] != b) {
+        ram[page][col] = b;
+        changed = true;
+    }
+    if (col == col_end) {
+        col = col_start;
+        page = page == page_end ? page_start : page + 1;
+    } else {
+        col = (col + 1) % SSD1306_MODEL_WIDTH;
+    }
+}
+
+void ssd1306_model_write(const uint8_t *data, size_t len) {
+    size_t i = 0;
+    while (i < len) {
+        uint8_t control = data[i++];
+        bool continuation = control & 0x80;
+        bool is_data = control & 0x40;
+        // Co=1 means the control byte only covers the next byte, then another control byte follows
+        size_t end = continuation ? (i + 1 < len ? i + 1 : len) : len;
+        for (; i < end; i++) {
+            if (is_data) {
+                data_byte(data[i]);
+            } else {
+                command_byte(data[i]);
+            }
+        }
+    }
+}
+
+bool ssd1306_model_changed(void) {
+    return changed;
+}
+
+bool ssd1306_model_on(void) {
+    return display_on;
+}
+
+uint8_t ssd1306_model_ram(uint page, uint col) {
+    return ram[page % SSD1306_MODEL_PAGES][col % SSD1306_MODEL_WIDTH];
+}
+
+bool ssd1306_model_lit(void) {
+    if (!display_on) {
+        return false;
+    }
+    if (entire_on || inverted) {
+        return true;
+    }
+    for (int p = 0; p < SSD1306_MODEL_PAGES; p++) {
+        for (int x = 0; x < SSD1306_MODEL_WIDTH; x++) {
+            if (ram[p][x]) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ssd1306_model_dump_pbm(FILE *f, uint64_t time_us) {
+    // PBM is only black and white, so the contrast goes in a comment
+    fprintf(f, "P4\n# t=%llu us contrast=%d\n%d %d\n", (unsigned long long)time_us, contrast,
+            SSD1306_MODEL_WIDTH, SSD1306_MODEL_PAGES * 8);
+    for (int y = 0; y < SSD1306_MODEL_PAGES * 8; y++) {
+        for (int x = 0; x < SSD1306_MODEL_WIDTH; x += 8) {
+            uint8_t out = 0;
+            for (int k = 0; k < 8; k++) {
+                bool lit = (ram[y >> 3][x + k] >> (y & 7)) & 1;
+                lit = display_on && (entire_on || (lit != inverted));
+                // PBM 1 is black
+                if (!lit) {
+                    out |= 0x80 >> k;
+                }
+            }
+            fputc(out, f);
+        }
+    }
+    changed = false;
+}
@@ -0,0 +1,29 @@
+#ifndef _inc_ssd1306_model
+#define _inc_ssd1306_model
+
+#include <stdio.h>
+#include "pico.h"
+
+// an in-memory SSD1306 (128x64, i2c) that understands the same command set the driver sends
+
+#define SSD1306_MODEL_ADDRESS 0x3C
+#define SSD1306_MODEL_WIDTH 128
+#define SSD1306_MODEL_PAGES 8
+
+// one i2c write transaction to the display (everything after the address byte)
+void ssd1306_model_write(const uint8_t *data, size_t len);
+
+// true if what the panel shows has changed since the last ssd1306_model_dump_pbm
+bool ssd1306_model_changed(void);
+
+// if the panel is switched on, and if anything on it is lit up
+bool ssd1306_model_on(void);
+bool ssd1306_model_lit(void);
+
+// a byte of the panel's ram: 8 pixels of column col, from the top of page
+uint8_t ssd1306_model_ram(uint page, uint col);
+
+// write what the panel is showing as a binary PBM, lit pixels white on black
+void ssd1306_model_dump_pbm(FILE *f, uint64_t time_us);
+
+#endif
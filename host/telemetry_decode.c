@@ -0,0 +1,203 @@
+// decodes spedo's binary telemetry (see telemetry.h), live from the pico's USB serial port or from a file:
+//   telemetry_decode /dev/ttyACM0 --record ride.bin
+//   telemetry_decode ride.bin
+//   spedo_host | telemetry_decode -
+//
+// prints a csv line per frame, the columns depending on the first one:
+//   edge,time_us,closed,channel
+//   state,time_us,state
+//   stats,time_us,dist_mm,all_time_s,moving_time_s,speed_kmh,max_kmh,av_kmh,accel_kmh_per_s,revs,dropped_edges,cadence_rpm
+//   histogram,time_us,name,count,mean_us,max_us,buckets...  (bucket 0 is 0us, then 1, 2-3, 4-7... see instr.h)
+//   counter,time_us,name,count
+// (the last two only when the instrumentation is dumped, by sending an 'i' to the serial port)
+// anything else on the stream (like a printf) goes to stderr, along with a count of lost and corrupt
+// frames at the end. --record saves the raw stream as it comes in, to be decoded again later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "telemetry.h"
+
+static uint32_t frames = 0;
+static uint32_t corrupt = 0;
+static uint32_t lost = 0;
+static bool have_seq = false;
+static uint16_t expected_seq;
+
+static uint64_t get_le(const uint8_t *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) {
+        v |= (uint64_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+static double kmh(uint32_t q8) {
+    return q8 / (double)(1 << SPEED_FRAC_BITS);
+}
+
+static void print_text(const uint8_t *p, size_t len) {
+    fprintf(stderr, "%.*s", (int)len, (const char *)p);
+}
+
+// the bytes between two 0x00s
+static void chunk(const uint8_t *p, size_t len) {
+    if (!len) {
+        return;
+    }
+    uint8_t frame[TELEMETRY_MAX_FRAME];
+    size_t n = telemetry_cobs_decode(p, len, frame, sizeof(frame));
+    if (n < 5 || telemetry_crc16(frame, n - 2) != get_le(&frame[n - 2], 2)) {
+        // not a frame, either text or something got corrupted
+        bool text = true;
+        for (size_t i = 0; i < len; i++) {
+            if ((p[i] < ' ' || p[i] > '~') && p[i] != '\n' && p[i] != '\r' && p[i] != '\t') {
+                text = false;
+            }
+        }
+        if (text) {
+            print_text(p, len);
+        } else {
+            corrupt++;
+        }
+        return;
+    }
+
+    frames++;
+    uint16_t seq = get_le(&frame[1], 2);
+    if (have_seq && seq != expected_seq) {
+        lost += (uint16_t)(seq - expected_seq);
+    }
+    have_seq = true;
+    expected_seq = seq + 1;
+
+    const uint8_t *body = &frame[3];
+    size_t body_len = n - 5;
+    uint64_t time_us = body_len >= TELEMETRY_TIME_BYTES ? get_le(body, TELEMETRY_TIME_BYTES) : 0;
+    const uint8_t *b = body + TELEMETRY_TIME_BYTES;
+    switch (frame[0]) {
+    case TELEMETRY_EDGE:
+        if (body_len == TELEMETRY_TIME_BYTES + 2) {
+            printf("edge,%llu,%d,%d\n", (unsigned long long)time_us, b[0], b[1]);
+            return;
+        }
+        break;
+    case TELEMETRY_STATE:
+        if (body_len == TELEMETRY_TIME_BYTES + 1) {
+            printf("state,%llu,%d\n", (unsigned long long)time_us, b[0]);
+            return;
+        }
+        break;
+    case TELEMETRY_STATS:
+        if (body_len == TELEMETRY_STATS_BYTES) {
+            printf("stats,%llu,%u,%u,%u,%.2f,%.2f,%.2f,%.2f,%u,%u,%u\n", (unsigned long long)time_us,
+                   (unsigned)get_le(b, 4), (unsigned)get_le(b + 4, 4), (unsigned)get_le(b + 8, 4),
+                   kmh(get_le(b + 12, 4)), kmh(get_le(b + 16, 4)), kmh(get_le(b + 20, 4)),
+                   (int32_t)get_le(b + 24, 4) / (double)(1 << SPEED_FRAC_BITS),
+                   (unsigned)get_le(b + 28, 4), (unsigned)get_le(b + 32, 2), (unsigned)get_le(b + 34, 2));
+            return;
+        }
+        break;
+    case TELEMETRY_HISTOGRAM:
+        if (body_len >= TELEMETRY_HISTOGRAM_BYTES(0) && body_len == (size_t)TELEMETRY_HISTOGRAM_BYTES(b[13])) {
+            printf("histogram,%llu,%s,%u,%u,%u", (unsigned long long)time_us, instr_hist_name(b[0]),
+                   (unsigned)get_le(b + 1, 4), (unsigned)get_le(b + 5, 4), (unsigned)get_le(b + 9, 4));
+            for (int i = 0; i < b[13]; i++) {
+                printf(",%u", (unsigned)get_le(b + 14 + 4 * i, 4));
+            }
+            printf("\n");
+            return;
+        }
+        break;
+    case TELEMETRY_COUNTERS:
+        if (body_len >= TELEMETRY_COUNTERS_BYTES(0) && body_len == (size_t)TELEMETRY_COUNTERS_BYTES(b[0])) {
+            for (int i = 0; i < b[0]; i++) {
+                printf("counter,%llu,%s,%u\n", (unsigned long long)time_us, instr_counter_name(i),
+                       (unsigned)get_le(b + 1 + 4 * i, 4));
+            }
+            return;
+        }
+        break;
+    }
+    fprintf(stderr, "unknown frame type %d (%zu bytes)\n", frame[0], body_len);
+}
+
+static int open_input(const char *path) {
+    if (!strcmp(path, "-")) {
+        return STDIN_FILENO;
+    }
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    // the pico's serial port, take the bytes exactly as they come
+    struct termios tio;
+    if (isatty(fd) && tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    const char *record_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (!path) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "usage: %s [--record FILE] SERIAL_PORT|FILE|-\n", argv[0]);
+        return 1;
+    }
+
+    int fd = open_input(path);
+    FILE *record = NULL;
+    if (record_path && !(record = fopen(record_path, "wb"))) {
+        fprintf(stderr, "can't write %s: %s\n", record_path, strerror(errno));
+        return 1;
+    }
+
+    // bytes since the last 0x00, anything longer than a frame can't be one so is only kept for printing
+    uint8_t pending[256];
+    size_t pending_len = 0;
+    uint8_t buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        if (record) {
+            fwrite(buf, 1, n, record);
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] == 0) {
+                chunk(pending, pending_len);
+                pending_len = 0;
+            } else {
+                if (pending_len == sizeof(pending)) {
+                    chunk(pending, pending_len);
+                    pending_len = 0;
+                }
+                pending[pending_len++] = buf[i];
+            }
+        }
+        fflush(stdout);
+    }
+    chunk(pending, pending_len);
+
+    if (record) {
+        fclose(record);
+    }
+    fprintf(stderr, "%u frames, %u lost, %u corrupt\n", frames, lost, corrupt);
+    return 0;
+}
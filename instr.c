@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "instr.h"
+#include "telemetry.h"
+
+static const char *const hist_names[INSTR_HISTOGRAMS] = {
+    [INSTR_LOOP] = "loop",
+    [INSTR_TASK_LATE] = "task_late",
+    [INSTR_EDGE] = "edge",
+    [INSTR_OLED_DRAW] = "oled_draw",
+    [INSTR_OLED_BUS] = "oled_bus",
+    [INSTR_EDGE_TO_OLED] = "edge_to_oled",
+    [INSTR_TELEMETRY] = "telemetry",
+    [INSTR_FLASH] = "flash",
+};
+
+static const char *const counter_names[INSTR_COUNTERS] = {
+    [INSTR_MISSED_DEADLINES] = "missed_deadlines",
+    [INSTR_I2C_ABORTS] = "i2c_aborts",
+    [INSTR_OLED_BUSY] = "oled_busy",
+    [INSTR_FLASH_FAILED] = "flash_failed",
+};
+
+const char *instr_hist_name(instr_hist_t h) {
+    return h < INSTR_HISTOGRAMS ? hist_names[h] : "?";
+}
+
+const char *instr_counter_name(instr_counter_t c) {
+    return c < INSTR_COUNTERS ? counter_names[c] : "?";
+}
+
+#if SPEDO_INSTR
+
+// each one is only ever written by one core (the OLED ones by whichever owns the OLED), and a dump that
+// reads one while it is being written is at worst a count out
+static instr_histogram_t histograms[INSTR_HISTOGRAMS];
+static uint32_t counters[INSTR_COUNTERS];
+
+void instr_record(instr_hist_t h, uint32_t value) {
+    instr_histogram_t *hist = &histograms[h];
+    hist->count++;
+    hist->total += value;
+    if (value > hist->max) {
+        hist->max = value;
+    }
+    hist->buckets[instr_bucket(value)]++;
+}
+
+void instr_count(instr_counter_t c, uint32_t n) {
+    counters[c] += n;
+}
+
+void instr_reset(void) {
+    memset(histograms, 0, sizeof(histograms));
+    memset(counters, 0, sizeof(counters));
+}
+
+#if !SPEDO_TELEMETRY
+// a line per histogram: how many, the mean and max, then the count in each bucket up to the last non-empty one
+static void print_histogram(const char *name, const instr_histogram_t *hist) {
+    uint last = INSTR_BUCKETS;
+    while (last && !hist->buckets[last - 1]) {
+        last--;
+    }
+    printf("%-16s %8lu %8lu %8lu |", name, (unsigned long)hist->count,
+           (unsigned long)(hist->count ? hist->total / hist->count : 0), (unsigned long)hist->max);
+    for (uint b = 0; b < last; b++) {
+        printf(" %lu", (unsigned long)hist->buckets[b]);
+    }
+    printf("\n");
+}
+#endif
+
+void instr_dump(uint64_t now_us) {
+#if SPEDO_TELEMETRY
+    for (uint h = 0; h < INSTR_HISTOGRAMS; h++) {
+        telemetry_histogram(now_us, h, &histograms[h]);
+    }
+    telemetry_counters(now_us, counters, INSTR_COUNTERS);
+#else
+    printf("----- INSTRUMENTATION at %lu ms -----\n", (unsigned long)(now_us / 1000));
+    printf("%-16s %8s %8s %8s | buckets: 0, 1, 2-3, 4-7 ... us\n", "", "count", "mean us", "max us");
+    for (uint h = 0; h < INSTR_HISTOGRAMS; h++) {
+        print_histogram(hist_names[h], &histograms[h]);
+    }
+    for (uint c = 0; c < INSTR_COUNTERS; c++) {
+        printf("%-16s %8lu\n", counter_names[c], (unsigned long)counters[c]);
+    }
+#endif
+}
+
+void instr_poll(uint64_t now_us) {
+    int c;
+    while ((c = getchar_timeout_us(0)) >= 0) {
+        if (c == 'i') {
+            instr_dump(now_us);
+        } else if (c == 'r') {
+            instr_reset();
+        }
+    }
+}
+
+#endif
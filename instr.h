@@ -0,0 +1,89 @@
+#ifndef _inc_instr
+#define _inc_instr
+
+#include "pico/stdlib.h"
+
+// instrumentation of the hot paths: how long things take and how late they happen, kept as log2
+// histograms (plus a few plain counters) so there is a picture of the worst cases as well as the usual,
+// in a fixed bit of RAM however long the ride. typing 'i' on the USB serial port dumps them without
+// stopping anything ('r' starts them again from zero): as telemetry frames (see telemetry.h), or a table
+// with the human readable log.
+// times are time_us_32() differences - the M0+ has no cycle counter, and the microsecond timer is a
+// single register read. set SPEDO_INSTR to 0 and all of it compiles to nothing
+#ifndef SPEDO_INSTR
+#define SPEDO_INSTR 1
+#endif
+
+typedef enum {
+    INSTR_LOOP,         // mainloop, from waking up to going back to sleep
+    INSTR_TASK_LATE,    // scheduled tasks, how long after their deadline they ran
+    INSTR_EDGE,         // reed switch edge to the mainloop taking it
+    INSTR_OLED_DRAW,    // drawing a frame on the OLED and building its dma stream
+    INSTR_OLED_BUS,     // a frame going out over i2c (on core0, only the ones another frame had to wait for)
+    INSTR_EDGE_TO_OLED, // reed switch edge to the frame with its speed starting to go out
+    INSTR_TELEMETRY,    // writing a telemetry frame to stdio
+    INSTR_FLASH,        // writing the ride log, with interrupts off
+    INSTR_HISTOGRAMS
+} instr_hist_t;
+
+typedef enum {
+    INSTR_MISSED_DEADLINES, // tasks that ran over INSTR_MISSED_US late
+    INSTR_I2C_ABORTS,       // i2c transfers to the OLED that weren't acknowledged
+    INSTR_OLED_BUSY,        // frames that had to wait for the last one to finish going out
+    INSTR_FLASH_FAILED,     // ride log writes that couldn't lock the other core out, and were tried again later
+    INSTR_COUNTERS
+} instr_counter_t;
+
+// a task this late has missed its tick (what the old fixed rate mainloop used to catch up on)
+#define INSTR_MISSED_US 1000
+
+// bucket 0 is 0us, bucket n is 2^(n-1) to 2^n - 1 us, and the last one everything from ~4s up
+#define INSTR_BUCKETS 24
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint64_t total;
+    uint32_t buckets[INSTR_BUCKETS];
+} instr_histogram_t;
+
+// what each one is called in the dump
+const char *instr_hist_name(instr_hist_t h);
+const char *instr_counter_name(instr_counter_t c);
+
+// the bucket value goes in
+static inline uint instr_bucket(uint32_t value) {
+    uint b = value ? 32 - __builtin_clz(value) : 0;
+    return b < INSTR_BUCKETS ? b : INSTR_BUCKETS - 1;
+}
+
+#if SPEDO_INSTR
+
+void instr_record(instr_hist_t h, uint32_t value);
+void instr_count(instr_counter_t c, uint32_t n);
+void instr_reset(void);
+
+// send every histogram and the counters out on stdio
+void instr_dump(uint64_t now_us);
+
+// look for a command on the USB serial port, call from the mainloop
+void instr_poll(uint64_t now_us);
+
+// INSTR_STAMP(t) then INSTR_SINCE(h, t) records the time in between
+#define INSTR_STAMP(t) uint32_t t = time_us_32()
+#define INSTR_SINCE(h, t) instr_record((h), time_us_32() - (t))
+#define INSTR_RECORD(h, value) instr_record((h), (value))
+#define INSTR_COUNT(c, n) instr_count((c), (n))
+#define INSTR_POLL(now_us) instr_poll(now_us)
+
+#else
+
+#define INSTR_STAMP(t)
+#define INSTR_SINCE(h, t) ((void)0)
+#define INSTR_RECORD(h, value) ((void)0)
+#define INSTR_COUNT(c, n) ((void)0)
+#define INSTR_POLL(now_us) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,235 @@
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+
+#include "reed.h"
+
+#if REED_PIO
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+#include "reed_capture.pio.h"
+#endif
+
+// number of edges that can be waiting for the mainloop, must be a power of 2
+// (the mainloop can stall for ~25ms drawing the OLED, and a magnet pass is only a couple of edges)
+#define REED_BUFFER_SIZE 32
+
+// single producer (the gpio interrupt, or the mainloop taking edges out of the PIO rings) / single
+// consumer (the mainloop) ring buffer, shared by all the channels.
+// head and tail only ever count up and are masked when indexing, so no lock is needed:
+// the producer only writes head, the consumer only writes tail
+static reed_edge_t buffer[REED_BUFFER_SIZE];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+static volatile uint32_t dropped = 0;
+
+void reed_push_edge(uint channel, uint64_t time_us, bool closed) {
+    uint32_t h = head;
+    if (h - tail >= REED_BUFFER_SIZE) {
+        // full - keep the older edges since they are the ones the speed is measured from
+        dropped++;
+        return;
+    }
+    buffer[h & (REED_BUFFER_SIZE - 1)].time_us = time_us;
+    buffer[h & (REED_BUFFER_SIZE - 1)].closed = closed;
+    buffer[h & (REED_BUFFER_SIZE - 1)].channel = channel;
+    __dmb(); // make sure the edge is written before the consumer can see it
+    head = h + 1;
+}
+
+#if REED_PIO
+static void take_captured_edges(void);
+#endif
+
+bool reed_pop_edge(reed_edge_t *edge) {
+#if REED_PIO
+    take_captured_edges();
+#endif
+    uint32_t t = tail;
+    if (t == head) {
+        return false;
+    }
+    __dmb(); // don't read the edge before seeing that head has moved past it
+    *edge = buffer[t & (REED_BUFFER_SIZE - 1)];
+    __dmb(); // finish reading before the producer is allowed to overwrite it
+    tail = t + 1;
+    return true;
+}
+
+uint32_t reed_dropped_edges(void) {
+    return dropped;
+}
+
+#if REED_PIO
+
+// the state machine's clock ticks at 8MHz, 4 cycles a tick (see reed_capture.pio)
+#define TICKS_PER_US 8
+#define CYCLES_PER_TICK 4
+
+// words the DMA writes into, a ring of 2^RING_BITS bytes per channel. the mainloop reads them within a few
+// ms, but the OLED or a flash write can hold it up for a few revolutions
+#define RING_BITS 7
+#define RING_WORDS ((1 << RING_BITS) / 4)
+
+typedef struct {
+    uint32_t ring[RING_WORDS] __attribute__((aligned(1 << RING_BITS)));
+    uint32_t ring_tail; // words taken out of the ring, counting up forever
+    uint dma_chan;
+    uint64_t start_us; // when the state machine's clock started
+} channel_t;
+
+static channel_t channels[REED_MAX_CHANNELS];
+static int8_t sm_channel[NUM_PIO_STATE_MACHINES]; // which channel each of pio0's state machines is capturing
+static int program_offset = -1; // where reed_capture is in pio0, once it has been loaded
+
+// channels whose state machine has pushed an edge since they were last looked at, set by the interrupt
+static volatile uint32_t pending = 0;
+
+// words the DMA has written into the ring. the transfer count goes down from 0xffffffff, which at a few
+// edges a second will never run out
+static uint32_t ring_head(const channel_t *ch) {
+    return 0xffffffff - dma_channel_hw_addr(ch->dma_chan)->transfer_count;
+}
+
+// the state machine's clock wraps every ~9 minutes, far longer than an edge ever waits in the ring. so
+// the edge happened in the last wrap before now (with a ms to spare for start_us being a bit late)
+static uint64_t tick_to_us(const channel_t *ch, uint32_t x) {
+    uint64_t now_ticks = (time_us_64() - ch->start_us + 1000) * TICKS_PER_US;
+    uint32_t ticks_ago = (uint32_t)now_ticks - (0xffffffff - x);
+    return ch->start_us + (now_ticks - ticks_ago) / TICKS_PER_US;
+}
+
+// move everything the DMA has put in a channel's ring into the edge buffer. the edges alternate, starting
+// with a close, so which one each word is comes from where it is in the ring
+static void take_channel_edges(uint channel) {
+    channel_t *ch = &channels[channel];
+    uint32_t h = ring_head(ch);
+    while (ch->ring_tail != h) {
+        if (h - ch->ring_tail > RING_WORDS) {
+            // the DMA has gone all the way round and overwritten some
+            dropped += h - ch->ring_tail - RING_WORDS;
+            ch->ring_tail = h - RING_WORDS;
+        }
+        uint32_t x = ch->ring[ch->ring_tail % RING_WORDS];
+        if (ring_head(ch) - ch->ring_tail > RING_WORDS) {
+            h = ring_head(ch); // overwritten while it was being read
+            continue;
+        }
+        reed_push_edge(channel, tick_to_us(ch, x), !(ch->ring_tail & 1));
+        ch->ring_tail++;
+    }
+}
+
+// only the channels that have raised their interrupt. by the time the interrupt has been taken, the DMA
+// has long since moved the word out of the RX FIFO
+static void take_captured_edges(void) {
+    if (!pending) {
+        return;
+    }
+    uint32_t save = save_and_disable_interrupts();
+    uint32_t channels_pending = pending;
+    pending = 0;
+    restore_interrupts(save);
+    while (channels_pending) {
+        uint channel = __builtin_ctz(channels_pending);
+        channels_pending &= channels_pending - 1;
+        take_channel_edges(channel);
+    }
+}
+
+// each state machine raises its own interrupt flag (irq 0 rel) for every edge, which wakes a wfe up and
+// says which channel to look at
+static void reed_pio_irq(void) {
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (sm_channel[sm] >= 0 && pio_interrupt_get(pio0, sm)) {
+            pio_interrupt_clear(pio0, sm);
+            pending |= 1u << sm_channel[sm];
+        }
+    }
+}
+
+void reed_init(uint channel, uint gpio, uint32_t debounce_us) {
+    hard_assert(channel < REED_MAX_CHANNELS); // it indexes channels[], and is a bit in pending
+    channel_t *ch = &channels[channel];
+
+    // the PIO can read a gpio whatever function it is set to, so it stays a plain input
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_IN);
+    gpio_pull_up(gpio);
+
+    PIO pio = pio0;
+    if (program_offset < 0) {
+        program_offset = pio_add_program(pio, &reed_capture_program);
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+            sm_channel[sm] = -1;
+        }
+        irq_set_exclusive_handler(PIO0_IRQ_0, reed_pio_irq);
+        irq_set_enabled(PIO0_IRQ_0, true);
+    }
+    uint sm = pio_claim_unused_sm(pio, true);
+    sm_channel[sm] = channel;
+    pio_sm_config c = reed_capture_program_get_default_config(program_offset);
+    sm_config_set_jmp_pin(&c, gpio);
+    // clk_sys / 32MHz, in 1/256ths
+    uint32_t div = (uint32_t)((uint64_t)clock_get_hz(clk_sys) * 256 / (TICKS_PER_US * CYCLES_PER_TICK * 1000000));
+    sm_config_set_clkdiv_int_frac(&c, div >> 8, div & 0xff);
+    pio_sm_init(pio, sm, program_offset, &c);
+    pio_sm_put(pio, sm, debounce_us * TICKS_PER_US);
+
+    ch->ring_tail = 0;
+    ch->dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config d = dma_channel_get_default_config(ch->dma_chan);
+    channel_config_set_transfer_data_size(&d, DMA_SIZE_32);
+    channel_config_set_read_increment(&d, false);
+    channel_config_set_write_increment(&d, true);
+    channel_config_set_ring(&d, true, RING_BITS);
+    channel_config_set_dreq(&d, pio_get_dreq(pio, sm, false));
+    dma_channel_configure(ch->dma_chan, &d, ch->ring, &pio->rxf[sm], 0xffffffff, true);
+
+    pio_set_irq0_source_enabled(pio, (enum pio_interrupt_source)(pis_interrupt0 + sm), true);
+
+    ch->start_us = time_us_64();
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+#else
+
+static int8_t gpio_channel[NUM_BANK0_GPIOS]; // which channel each gpio is, 0 until it is set up
+
+static void reed_irq_callback(uint gpio, uint32_t events) {
+    uint64_t now = time_us_64(); // timestamp as early as possible
+    if (gpio >= NUM_BANK0_GPIOS || !gpio_channel[gpio]) {
+        return;
+    }
+    uint channel = gpio_channel[gpio] - 1;
+    // the reed switch pulls the gpio to ground, so falling = closed and rising = open
+    bool fell = events & GPIO_IRQ_EDGE_FALL;
+    bool rose = events & GPIO_IRQ_EDGE_RISE;
+    if (fell && rose) {
+        // bounced faster than the interrupt could be serviced, the current level says which came last
+        bool closed_now = !gpio_get(gpio);
+        reed_push_edge(channel, now, !closed_now);
+        reed_push_edge(channel, now, closed_now);
+    } else if (fell) {
+        reed_push_edge(channel, now, true);
+    } else if (rose) {
+        reed_push_edge(channel, now, false);
+    }
+}
+
+void reed_init(uint channel, uint gpio, uint32_t debounce_us) {
+    (void)debounce_us; // only the edge filter debounces the edges the interrupt sees
+    hard_assert(channel < REED_MAX_CHANNELS); // edges carry it to the mainloop, which only has this many
+    gpio_channel[gpio] = channel + 1;
+
+    // init reed switch gpio as a button
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_IN);
+    gpio_pull_up(gpio);
+
+    gpio_set_irq_enabled_with_callback(gpio, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true, &reed_irq_callback);
+}
+
+#endif
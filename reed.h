@@ -0,0 +1,48 @@
+#ifndef _inc_reed
+#define _inc_reed
+
+#include "pico/stdlib.h"
+
+// reed switch sensors (the wheel, the cranks...), each on its own gpio as a channel. their edges all come
+// out of one queue, tagged with the channel, so the mainloop takes them in one place however many there are.
+//
+// the edges are captured with a PIO state machine per channel, all running the one program
+// (reed_capture.pio) on pio0, which debounces and timestamps them in hardware and DMAs them into a ring
+// per channel, so the CPU does nothing until the mainloop reads them. only channels that have raised
+// their PIO interrupt since are looked at, so more channels doesn't make the mainloop any slower.
+// 0 timestamps them in a gpio interrupt instead
+#ifndef REED_PIO
+#define REED_PIO 1
+#endif
+
+// how long the PIO wants a new level to hold before it counts as an edge, unless a channel says otherwise.
+// the magnet can keep the wheel's switch closed for as little as ~0.5ms at speed, so this has to be well
+// under that
+#define REED_PIO_DEBOUNCE_US 200
+
+// a state machine and a dma channel each, and there are 4 state machines in pio0
+#define REED_MAX_CHANNELS 4
+
+// a single reed switch transition, timestamped as it happened (by the PIO, or in the gpio interrupt)
+typedef struct {
+    uint64_t time_us; // time_us_64() when the edge was seen
+    bool closed;      // true if the reed switch closed (magnet arrived), false if it opened
+    uint8_t channel;  // which sensor
+} reed_edge_t;
+
+// set up a reed switch on gpio as channel (below REED_MAX_CHANNELS), and start capturing its edges in the
+// background. a new level has to hold for debounce_us (with the PIO) to count
+void reed_init(uint channel, uint gpio, uint32_t debounce_us);
+
+// take the oldest captured edge out of the buffer, returns false if there isn't one. edges from one
+// channel come out in order, but not necessarily in time order with the other channels'
+bool reed_pop_edge(reed_edge_t *edge);
+
+// add an edge to the buffer - this is what the gpio interrupt calls (or reed_pop_edge, for the edges the
+// PIO captured), but it can be called directly to feed edges in from somewhere else (e.g. a simulated reed switch)
+void reed_push_edge(uint channel, uint64_t time_us, bool closed);
+
+// number of edges thrown away because the buffer was full
+uint32_t reed_dropped_edges(void);
+
+#endif
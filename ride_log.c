@@ -0,0 +1,335 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+
+#include "instr.h"
+#include "ride_log.h"
+
+// FORMAT
+//
+// the log is a ring of flash sectors, each starting with a sector_header_t. the sequence numbers go up
+// by one for every sector written, so the oldest and newest sectors can be found after a reboot.
+//
+// after the header are records, each is a varint (7 bits a byte, least significant first, top bit set
+// on all but the last byte):
+//   even: a revolution. the varint/2 is the zigzag encoded difference between this interval and the
+//         last one, so a steady speed is 1-3 bytes. the first one in a sector is relative to the header's
+//         prev_interval_us, and after any other record it is from 0
+//   odd:  record type (ride_log_type_t) is the varint/2, followed by a varint of its value
+// a record never crosses a page, and a byte of 0xff where a record should start means the rest of the
+// page is unused (neither kind of record can start with 0xff, since types are < 63)
+
+#define RIDE_LOG_MAGIC 0x474f4c52 // "RLOG"
+#define RIDE_LOG_SECTORS (RIDE_LOG_SIZE / FLASH_SECTOR_SIZE)
+
+// so that the difference between two intervals always fits in a record (this is ~9 minutes)
+#define MAX_INTERVAL_US ((1u << 29) - 1)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t prev_interval_us;
+} sector_header_t;
+
+// number of full pages that can wait in RAM to be programmed, must be a power of 2
+// (a page is ~80 revolutions, so this is plenty as long as ride_log_service gets called every revolution)
+#define PAGE_QUEUE_SIZE 4
+
+// number of sectors to keep erased ahead of the log, so that a ride rarely has to wait for an erase
+// (a sector lasts ~3km, and they are erased while stationary)
+#define ERASE_AHEAD_SECTORS 8
+
+// positions are byte offsets into the log that count up forever, and wrap round the flash region.
+// RIDE_LOG_SIZE is a power of 2 so they stay correct when the uint32_t overflows too
+static uint8_t pages[PAGE_QUEUE_SIZE][FLASH_PAGE_SIZE];
+static uint32_t page_pos[PAGE_QUEUE_SIZE];
+static uint32_t queue_head = 0; // pages[queue_head] is being filled, the ones from queue_tail up to it are full
+static uint32_t queue_tail = 0;
+static uint32_t page_len = 0;  // bytes used in the page being filled, 0 if it isn't started
+static uint32_t write_pos = 0; // where the page being filled goes
+static uint32_t erased_pos = 0; // everything from the oldest waiting page up to here is erased
+static uint32_t seq = 0;        // of the last sector started
+static uint32_t prev_interval_us = 0;
+static uint32_t dropped = 0;
+
+static const uint8_t *flash_region(void) {
+    return (const uint8_t *)(XIP_BASE + RIDE_LOG_OFFSET);
+}
+
+static const sector_header_t *sector_header(const uint8_t *region, uint32_t sector) {
+    return (const sector_header_t *)(region + sector * FLASH_SECTOR_SIZE);
+}
+
+static bool is_blank(const uint8_t *p, uint32_t len) {
+    const uint32_t *words = (const uint32_t *)p;
+    for (uint32_t i = 0; i < len / 4; i++) {
+        if (words[i] != 0xffffffff) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t put_varint(uint8_t *out, uint32_t v) {
+    uint32_t len = 0;
+    while (v >= 0x80) {
+        out[len++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    out[len++] = v;
+    return len;
+}
+
+// returns false if the varint is broken or runs past end
+static bool get_varint(const uint8_t *p, uint32_t *offset, uint32_t end, uint32_t *v) {
+    *v = 0;
+    for (uint32_t shift = 0; shift < 35 && *offset < end; shift += 7) {
+        uint8_t b = p[(*offset)++];
+        *v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// WRITING ----------------------------------------------------------------------------
+
+static void finish_page(void) {
+    if (page_len == 0) {
+        return;
+    }
+    if (page_len == sizeof(sector_header_t) && write_pos % FLASH_SECTOR_SIZE == 0) {
+        return; // nothing but a header, keep filling it
+    }
+    page_pos[queue_head & (PAGE_QUEUE_SIZE - 1)] = write_pos;
+    queue_head++;
+    write_pos += FLASH_PAGE_SIZE;
+    page_len = 0;
+}
+
+static void append(const uint8_t *record, uint32_t len, bool is_rev, uint32_t interval_us) {
+    if (page_len + len > FLASH_PAGE_SIZE) {
+        finish_page();
+    }
+    if (page_len == 0) {
+        if (queue_head - queue_tail >= PAGE_QUEUE_SIZE) {
+            dropped++; // nowhere to put it
+            return;
+        }
+        uint8_t *page = pages[queue_head & (PAGE_QUEUE_SIZE - 1)];
+        memset(page, 0xff, FLASH_PAGE_SIZE);
+        if (write_pos % FLASH_SECTOR_SIZE == 0) {
+            sector_header_t header = {
+                .magic = RIDE_LOG_MAGIC,
+                .seq = ++seq,
+                .prev_interval_us = prev_interval_us,
+            };
+            memcpy(page, &header, sizeof(header));
+            page_len = sizeof(header);
+        }
+    }
+    memcpy(&pages[queue_head & (PAGE_QUEUE_SIZE - 1)][page_len], record, len);
+    page_len += len;
+    prev_interval_us = is_rev ? interval_us : 0;
+}
+
+static void append_event(ride_log_type_t type, uint32_t value) {
+    uint8_t record[10];
+    uint32_t len = put_varint(record, type << 1 | 1);
+    len += put_varint(&record[len], value);
+    append(record, len, false, 0);
+}
+
+void ride_log_revolution(uint32_t interval_us) {
+    if (interval_us > MAX_INTERVAL_US) {
+        interval_us = MAX_INTERVAL_US; // way past being stopped anyway
+    }
+    int32_t delta = (int32_t)(interval_us - prev_interval_us);
+    uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    uint8_t record[5];
+    uint32_t len = put_varint(record, zigzag << 1);
+    append(record, len, true, interval_us);
+}
+
+void ride_log_start(uint32_t ms_since_boot) {
+    append_event(RIDE_LOG_START, ms_since_boot);
+}
+
+void ride_log_stop(uint32_t ms_since_boot) {
+    append_event(RIDE_LOG_STOP, ms_since_boot);
+    finish_page();
+}
+
+uint32_t ride_log_dropped(void) {
+    return dropped;
+}
+
+typedef struct {
+    uint32_t offset;
+    const uint8_t *data; // NULL to erase
+} flash_op_t;
+
+// runs with interrupts off and the other core locked out, since nothing can run from flash while it is busy
+static void __not_in_flash_func(do_flash_op)(void *param) {
+    flash_op_t *op = param;
+    if (op->data) {
+        flash_range_program(op->offset, op->data, FLASH_PAGE_SIZE);
+    } else {
+        flash_range_erase(op->offset, FLASH_SECTOR_SIZE);
+    }
+}
+
+// returns false if it couldn't get at the flash (the other core didn't let go in time), and nothing was done
+static bool flash_op(flash_op_t *op) {
+    INSTR_STAMP(start);
+    int rc = flash_safe_execute(do_flash_op, op, 10);
+    INSTR_SINCE(INSTR_FLASH, start);
+    if (rc != PICO_OK) {
+        INSTR_COUNT(INSTR_FLASH_FAILED, 1);
+        return false;
+    }
+    return true;
+}
+
+bool ride_log_service(uint32_t budget_us) {
+    flash_op_t op;
+    uint32_t oldest = queue_tail != queue_head ? page_pos[queue_tail & (PAGE_QUEUE_SIZE - 1)] : write_pos;
+    if (queue_tail != queue_head && (int32_t)(erased_pos - oldest) >= (int32_t)FLASH_PAGE_SIZE) {
+        if (budget_us < RIDE_LOG_PROGRAM_US) {
+            return false;
+        }
+        op.offset = RIDE_LOG_OFFSET + oldest % RIDE_LOG_SIZE;
+        op.data = pages[queue_tail & (PAGE_QUEUE_SIZE - 1)];
+        if (!flash_op(&op)) {
+            return false; // the page stays queued, for the next call to try again
+        }
+        queue_tail++;
+        return true;
+    }
+    if ((int32_t)(erased_pos - oldest) < (int32_t)(ERASE_AHEAD_SECTORS * FLASH_SECTOR_SIZE)) {
+        if (budget_us < RIDE_LOG_ERASE_US) {
+            return false;
+        }
+        op.offset = RIDE_LOG_OFFSET + erased_pos % RIDE_LOG_SIZE;
+        op.data = NULL;
+        if (!flash_op(&op)) {
+            return false; // and the same sector again next time
+        }
+        erased_pos += FLASH_SECTOR_SIZE;
+        return true;
+    }
+    return false;
+}
+
+void ride_log_init(void) {
+    const uint8_t *region = flash_region();
+
+    // carry on after the newest sector
+    bool found = false;
+    uint32_t newest = 0;
+    for (uint32_t s = 0; s < RIDE_LOG_SECTORS; s++) {
+        const sector_header_t *h = sector_header(region, s);
+        if (h->magic == RIDE_LOG_MAGIC && (!found || h->seq > seq)) {
+            found = true;
+            newest = s;
+            seq = h->seq;
+        }
+    }
+    if (found) {
+        // pages are written in order, so the first blank one is where it got to
+        write_pos = (newest + 1) * FLASH_SECTOR_SIZE;
+        for (uint32_t p = FLASH_PAGE_SIZE; p < FLASH_SECTOR_SIZE; p += FLASH_PAGE_SIZE) {
+            if (is_blank(region + newest * FLASH_SECTOR_SIZE + p, FLASH_PAGE_SIZE)) {
+                write_pos = newest * FLASH_SECTOR_SIZE + p;
+                break;
+            }
+        }
+    }
+
+    // the rest of the sector it is in is erased, and maybe some after it
+    erased_pos = write_pos % FLASH_SECTOR_SIZE ? (write_pos / FLASH_SECTOR_SIZE + 1) * FLASH_SECTOR_SIZE : write_pos;
+    while (erased_pos - write_pos < ERASE_AHEAD_SECTORS * FLASH_SECTOR_SIZE &&
+           is_blank(region + erased_pos % RIDE_LOG_SIZE, FLASH_SECTOR_SIZE)) {
+        erased_pos += FLASH_SECTOR_SIZE;
+    }
+
+    append_event(RIDE_LOG_BOOT, 0);
+}
+
+// READING ----------------------------------------------------------------------------
+
+static void start_sector(ride_log_reader_t *r) {
+    const sector_header_t *h = sector_header(r->region, r->sector);
+    r->seq = h->seq;
+    r->offset = sizeof(sector_header_t);
+    r->prev_interval_us = h->prev_interval_us;
+}
+
+void ride_log_reader_init(ride_log_reader_t *r, const uint8_t *region) {
+    r->region = region;
+    r->sectors_left = 0;
+
+    // the oldest sector is the one with the lowest sequence number, the log runs on from there
+    bool found = false;
+    for (uint32_t s = 0; s < RIDE_LOG_SECTORS; s++) {
+        const sector_header_t *h = sector_header(region, s);
+        if (h->magic == RIDE_LOG_MAGIC && (!found || h->seq < r->seq)) {
+            found = true;
+            r->sector = s;
+            r->seq = h->seq;
+        }
+    }
+    if (found) {
+        r->sectors_left = RIDE_LOG_SECTORS;
+        start_sector(r);
+    }
+}
+
+bool ride_log_read(ride_log_reader_t *r, ride_log_record_t *rec) {
+    while (r->sectors_left) {
+        if (r->offset >= FLASH_SECTOR_SIZE) {
+            // on to the next sector, as long as it carries on from this one
+            uint32_t next = (r->sector + 1) % RIDE_LOG_SECTORS;
+            const sector_header_t *h = sector_header(r->region, next);
+            r->sectors_left--;
+            if (!r->sectors_left || h->magic != RIDE_LOG_MAGIC || h->seq != r->seq + 1) {
+                r->sectors_left = 0;
+                return false;
+            }
+            r->sector = next;
+            start_sector(r);
+            continue;
+        }
+
+        const uint8_t *sector = r->region + r->sector * FLASH_SECTOR_SIZE;
+        uint32_t page_end = (r->offset / FLASH_PAGE_SIZE + 1) * FLASH_PAGE_SIZE;
+        uint32_t v, value;
+        if (sector[r->offset] == 0xff) {
+            r->offset = page_end; // rest of the page is unused
+            continue;
+        }
+        if (!get_varint(sector, &r->offset, page_end, &v)) {
+            r->offset = page_end; // corrupt, try the next page
+            continue;
+        }
+        if (!(v & 1)) {
+            uint32_t zigzag = v >> 1;
+            int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+            rec->type = RIDE_LOG_REV;
+            rec->value = r->prev_interval_us + delta;
+            r->prev_interval_us = rec->value;
+            return true;
+        }
+        if (!get_varint(sector, &r->offset, page_end, &value)) {
+            r->offset = page_end;
+            continue;
+        }
+        r->prev_interval_us = 0;
+        rec->type = v >> 1;
+        rec->value = value;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,67 @@
+#ifndef _inc_ride_log
+#define _inc_ride_log
+
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+
+// append-only log of every ride, kept in the last RIDE_LOG_SIZE bytes of flash (well clear of the
+// firmware). it is a ring, so once it is full the oldest rides are erased to make room.
+// at ~3 bytes a revolution, 512KB is a few hundred km
+#ifndef RIDE_LOG_SIZE
+#define RIDE_LOG_SIZE (512 * 1024) // must be a power of 2
+#endif
+#define RIDE_LOG_OFFSET (PICO_FLASH_SIZE_BYTES - RIDE_LOG_SIZE)
+
+typedef enum {
+    RIDE_LOG_REV,   // a wheel revolution, value = us since the previous one (or since the ride started)
+    RIDE_LOG_BOOT,  // powered on, value = 0. the ms values after this count from this boot
+    RIDE_LOG_START, // started moving, value = ms since boot
+    RIDE_LOG_STOP,  // stopped moving, value = ms since boot
+} ride_log_type_t;
+
+typedef struct {
+    ride_log_type_t type;
+    uint32_t value;
+} ride_log_record_t;
+
+// how long the flash is busy for each bit of work ride_log_service does (worst case is a lot longer for an erase,
+// but this is what the W25Q16 usually takes). interrupts are off for all of it, but the reed_capture PIO keeps
+// timestamping edges and the DMA keeps taking them, so only core0 gets to them late (with REED_PIO 0 the gpio
+// interrupt timestamps them, late)
+#define RIDE_LOG_PROGRAM_US 1000
+#define RIDE_LOG_ERASE_US 50000
+
+// find where the log got to and add a boot record
+void ride_log_init(void);
+
+// add records. these only go into RAM, they are written to flash by ride_log_service
+void ride_log_revolution(uint32_t interval_us); // each magnet going past, with more than one on the wheel
+void ride_log_start(uint32_t ms_since_boot);
+void ride_log_stop(uint32_t ms_since_boot); // also finishes off the current page so the ride is all saved
+
+// program a page or erase a sector if there is one waiting and it fits in budget_us, returns true
+// if anything was done. if the flash couldn't be got at, it is left waiting for the next call.
+// call this when no edges are expected for a while
+bool ride_log_service(uint32_t budget_us);
+
+// number of records thrown away because ride_log_service wasn't called often enough
+uint32_t ride_log_dropped(void);
+
+// READING ----------------------------------------------------------------------------
+
+typedef struct {
+    const uint8_t *region;     // RIDE_LOG_SIZE bytes of flash (or a copy of it)
+    uint32_t sector;           // sector being read
+    uint32_t sectors_left;     // including this one
+    uint32_t offset;           // next byte in the sector
+    uint32_t seq;              // sequence number of the sector
+    uint32_t prev_interval_us; // for undoing the delta encoding
+} ride_log_reader_t;
+
+// start reading at the oldest record in region
+void ride_log_reader_init(ride_log_reader_t *r, const uint8_t *region);
+
+// read the next record, returns false at the end of the log
+bool ride_log_read(ride_log_reader_t *r, ride_log_record_t *rec);
+
+#endif
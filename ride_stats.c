@@ -0,0 +1,96 @@
+#include "ride_stats.h"
+
+#include <string.h>
+
+// how far each split is, and how many checkpoints back it starts (to the nearest)
+static const uint32_t split_mm[RIDE_STATS_SPLITS] = {1000000, 5000000};
+#define SPLIT_CHECKPOINTS(mm) (((mm) + RIDE_STATS_CHECKPOINT_MM / 2) / RIDE_STATS_CHECKPOINT_MM)
+static const uint32_t split_checkpoints[RIDE_STATS_SPLITS] = {SPLIT_CHECKPOINTS(1000000), SPLIT_CHECKPOINTS(5000000)};
+_Static_assert(SPLIT_CHECKPOINTS(5000000) < RIDE_STATS_CHECKPOINTS, "RIDE_STATS_CHECKPOINTS is too few for a 5km split");
+
+void ride_stats_init(ride_stats_t *s) {
+    memset(s, 0, sizeof(*s));
+    s->checkpoint_end_mm = RIDE_STATS_CHECKPOINT_MM;
+    s->lap_end_mm = RIDE_STATS_LAP_MM;
+}
+
+// a checkpoint every RIDE_STATS_CHECKPOINT_MM, and see if the splits ending here are the best
+static void checkpoint(ride_stats_t *s, uint32_t moving_ms) {
+    s->checkpoints++;
+    s->checkpoint_ms[s->checkpoints & (RIDE_STATS_CHECKPOINTS - 1)] = moving_ms;
+    for (int i = 0; i < RIDE_STATS_SPLITS; i++) {
+        uint32_t n = split_checkpoints[i];
+        if (s->checkpoints < n) {
+            continue;
+        }
+        uint32_t ms = moving_ms - s->checkpoint_ms[(s->checkpoints - n) & (RIDE_STATS_CHECKPOINTS - 1)];
+        ms = (uint64_t)ms * split_mm[i] / (n * RIDE_STATS_CHECKPOINT_MM);
+        if (!s->best_split_ms[i] || ms < s->best_split_ms[i]) {
+            s->best_split_ms[i] = ms;
+        }
+    }
+}
+
+void ride_stats_revolution(ride_stats_t *s, uint32_t arc, uint32_t interval_us, speed_q8_t speed) {
+    s->revs++;
+    // kept to a fraction of a mm, so the rounding doesn't add up over the many magnets going past
+    uint64_t dist = (uint64_t)WHEEL_CIRCUMFERENCE_MM * arc + s->dist_frac;
+    s->dist_mm += (uint32_t)(dist / REV_ARC);
+    s->dist_frac = (uint32_t)(dist % REV_ARC);
+    s->moving_us += interval_us;
+    uint32_t moving_ms = (uint32_t)(s->moving_us / 1000);
+    if (speed > s->max_speed) {
+        s->max_speed = speed;
+    }
+
+    int kmh = speed_kmh(speed_from_arc_us(arc, interval_us));
+    if (kmh >= RIDE_STATS_MAX_KMH) {
+        kmh = RIDE_STATS_MAX_KMH - 1;
+    }
+    uint32_t ms = (interval_us + 500) / 1000;
+    s->kmh_ms[kmh] += ms;
+    s->zone_ms[kmh / RIDE_STATS_ZONE_KMH] += ms;
+    s->total_ms += ms;
+
+    if (s->dist_mm >= s->checkpoint_end_mm) {
+        s->checkpoint_end_mm += RIDE_STATS_CHECKPOINT_MM;
+        checkpoint(s, moving_ms);
+    }
+
+    if (speed > s->lap_max_speed) {
+        s->lap_max_speed = speed;
+    }
+    if (s->dist_mm >= s->lap_end_mm) {
+        ride_stats_lap_t *lap = &s->laps[s->laps_done++ & (RIDE_STATS_LAPS - 1)];
+        lap->moving_ms = moving_ms - s->lap_start_ms;
+        lap->max_speed = s->lap_max_speed;
+        s->lap_end_mm += RIDE_STATS_LAP_MM;
+        s->lap_start_ms = moving_ms;
+        s->lap_max_speed = 0;
+    }
+}
+
+speed_q8_t ride_stats_percentile(const ride_stats_t *s, uint pct) {
+    if (!s->total_ms) {
+        return 0;
+    }
+    uint32_t target = (uint64_t)s->total_ms * (pct < 100 ? pct : 100) / 100;
+    uint32_t below = 0; // time spent slower than kmh
+    for (int kmh = 0; kmh < RIDE_STATS_MAX_KMH; kmh++) {
+        uint32_t ms = s->kmh_ms[kmh];
+        if (ms && below + ms >= target) {
+            // somewhere in this km/h, assume the time was spread evenly across it
+            return ((speed_q8_t)kmh << SPEED_FRAC_BITS) +
+                   (speed_q8_t)(((uint64_t)(target - below) << SPEED_FRAC_BITS) / ms);
+        }
+        below += ms;
+    }
+    return (speed_q8_t)RIDE_STATS_MAX_KMH << SPEED_FRAC_BITS;
+}
+
+const ride_stats_lap_t *ride_stats_lap(const ride_stats_t *s, uint back) {
+    if (back >= s->laps_done || back >= RIDE_STATS_LAPS) {
+        return NULL;
+    }
+    return &s->laps[(s->laps_done - 1 - back) & (RIDE_STATS_LAPS - 1)];
+}
@@ -0,0 +1,97 @@
+#ifndef _inc_ride_stats
+#define _inc_ride_stats
+
+#include "pico/stdlib.h"
+#include "speed.h"
+
+// everything worked out about the riding since power on. each wheel revolution updates it in constant time,
+// it never grows, and all of it can be read off at any point without going back over the ride
+
+// time at each whole km/h up to RIDE_STATS_MAX_KMH (anything faster counts as the top one), for the
+// percentiles, and in RIDE_STATS_ZONE_KMH zones
+#define RIDE_STATS_MAX_KMH 80
+#define RIDE_STATS_ZONE_KMH 5
+#define RIDE_STATS_ZONES (RIDE_STATS_MAX_KMH / RIDE_STATS_ZONE_KMH)
+
+// the best splits are timed between checkpoints every RIDE_STATS_CHECKPOINT_REVS revolutions (~20m) of distance, and
+// scaled to the exact distance. so they can start up to a checkpoint away from the actual fastest stretch
+#define RIDE_STATS_CHECKPOINT_REVS 9
+#define RIDE_STATS_CHECKPOINT_MM (RIDE_STATS_CHECKPOINT_REVS * WHEEL_CIRCUMFERENCE_MM)
+#define RIDE_STATS_CHECKPOINTS 256 // must be a power of 2, and more than the longest split needs
+
+typedef enum {
+    RIDE_STATS_SPLIT_1KM,
+    RIDE_STATS_SPLIT_5KM,
+    RIDE_STATS_SPLITS
+} ride_stats_split_t;
+
+// a lap is every RIDE_STATS_LAP_MM of riding, and the last RIDE_STATS_LAPS of them are kept
+#define RIDE_STATS_LAP_MM 1000000
+#define RIDE_STATS_LAPS 16 // must be a power of 2
+
+typedef struct {
+    uint32_t moving_ms;   // how long it took, not counting stops
+    speed_q8_t max_speed;
+} ride_stats_lap_t;
+
+typedef struct {
+    uint32_t revs;         // timed revolutions (not the first one of each ride, which has nothing to time it from).
+                           // with several magnets on the wheel, each one going past
+    uint32_t dist_mm;
+    uint32_t dist_frac;    // and the part of a mm on top, out of REV_ARC
+    uint64_t moving_us;    // all the timed revolutions added up, so stops don't count
+    speed_q8_t max_speed;
+
+    uint32_t kmh_ms[RIDE_STATS_MAX_KMH]; // time spent at each whole km/h, in ms
+    uint32_t zone_ms[RIDE_STATS_ZONES];  // and in each zone
+    uint32_t total_ms;                   // all of kmh_ms added up
+
+    uint32_t best_split_ms[RIDE_STATS_SPLITS]; // 0 until that far has been ridden
+    uint32_t checkpoint_ms[RIDE_STATS_CHECKPOINTS]; // moving time at each checkpoint, the latest at checkpoints
+    uint32_t checkpoints;
+    uint32_t checkpoint_end_mm; // when the next one is
+
+    ride_stats_lap_t laps[RIDE_STATS_LAPS]; // the latest at laps_done - 1
+    uint32_t laps_done;
+    uint32_t lap_end_mm;   // when the current lap is done
+    uint32_t lap_start_ms; // moving time when it started
+    speed_q8_t lap_max_speed;
+} ride_stats_t;
+
+void ride_stats_init(ride_stats_t *s);
+
+// the wheel has gone arc (of REV_ARC, so all the way round with one magnet) in interval_us. speed is the
+// smoothed speed, which the max comes from (the histogram uses interval_us itself, so it is exactly how long
+// was spent at that speed)
+void ride_stats_revolution(ride_stats_t *s, uint32_t arc, uint32_t interval_us, speed_q8_t speed);
+
+static inline uint32_t ride_stats_moving_s(const ride_stats_t *s) {
+    return (uint32_t)(s->moving_us / 1000000);
+}
+
+// from the moving time to the us, not whole seconds, which would have it jumping about early in a ride
+// (mm per us is km per second, times 3600 for per hour)
+static inline speed_q8_t ride_stats_average(const ride_stats_t *s) {
+    if (!s->moving_us) {
+        return 0;
+    }
+    return (speed_q8_t)((uint64_t)s->dist_mm * (3600u << SPEED_FRAC_BITS) / s->moving_us);
+}
+
+// ms spent in zone (0 is 0-5 km/h, 1 is 5-10...). the top zone has everything faster in it too
+static inline uint32_t ride_stats_zone_ms(const ride_stats_t *s, uint zone) {
+    return zone < RIDE_STATS_ZONES ? s->zone_ms[zone] : 0;
+}
+
+// the speed under which pct% of the moving time was spent (50 is the median), to within a km/h or so
+speed_q8_t ride_stats_percentile(const ride_stats_t *s, uint pct);
+
+// how long the fastest stretch of that distance took, in ms, or 0 if it hasn't been ridden yet
+static inline uint32_t ride_stats_best_split_ms(const ride_stats_t *s, ride_stats_split_t split) {
+    return s->best_split_ms[split];
+}
+
+// a finished lap, 0 being the latest. NULL if there haven't been that many (or they have been dropped)
+const ride_stats_lap_t *ride_stats_lap(const ride_stats_t *s, uint back);
+
+#endif
@@ -0,0 +1,80 @@
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#include "instr.h"
+#include "sched.h"
+
+// armed tasks, soonest deadline first. there are only ever a handful, so a sorted list is plenty
+static sched_task_t *armed = NULL;
+static uint32_t wakeups = 0;
+#if SPEDO_INSTR
+static uint64_t woke_us = 0; // when sched_wait last returned, for INSTR_LOOP
+#endif
+
+void sched_cancel(sched_task_t *task) {
+    if (!task->armed) {
+        return;
+    }
+    for (sched_task_t **p = &armed; *p; p = &(*p)->next) {
+        if (*p == task) {
+            *p = task->next;
+            break;
+        }
+    }
+    task->armed = false;
+}
+
+void sched_at(sched_task_t *task, uint64_t deadline_us) {
+    sched_cancel(task);
+    task->deadline_us = deadline_us;
+    task->armed = true;
+    // after any with the same deadline, so they run in the order they were scheduled
+    sched_task_t **p = &armed;
+    while (*p && (*p)->deadline_us <= deadline_us) {
+        p = &(*p)->next;
+    }
+    task->next = *p;
+    *p = task;
+}
+
+void sched_in(sched_task_t *task, uint64_t delay_us) {
+    sched_at(task, time_us_64() + delay_us);
+}
+
+bool sched_run_due(void) {
+    bool ran = false;
+    uint64_t now = time_us_64();
+    while (armed && armed->deadline_us <= now) {
+        sched_task_t *task = armed;
+        armed = task->next;
+        task->armed = false;
+        INSTR_RECORD(INSTR_TASK_LATE, now - task->deadline_us);
+        if (now - task->deadline_us > INSTR_MISSED_US) {
+            INSTR_COUNT(INSTR_MISSED_DEADLINES, 1);
+        }
+        task->fn(task, now); // may arm itself (or anything else) again
+        ran = true;
+    }
+    return ran;
+}
+
+void sched_wait(void) {
+#if SPEDO_INSTR
+    if (woke_us) {
+        INSTR_RECORD(INSTR_LOOP, time_us_64() - woke_us);
+    }
+#endif
+    if (armed) {
+        best_effort_wfe_or_timeout(from_us_since_boot(armed->deadline_us));
+    } else {
+        __wfe();
+    }
+    wakeups++;
+#if SPEDO_INSTR
+    woke_us = time_us_64();
+#endif
+}
+
+uint32_t sched_wakeups(void) {
+    return wakeups;
+}
@@ -0,0 +1,43 @@
+#ifndef _inc_sched
+#define _inc_sched
+
+#include "pico/stdlib.h"
+
+// cooperative deadline scheduler for the mainloop. a task is a function to run once at a given time
+// (tasks that repeat schedule themselves again). nothing ever sleeps inside a task: the mainloop runs
+// whatever is due, then waits for the next deadline or an interrupt (like a reed switch edge),
+// whichever comes first - so it only wakes up when there is something to do
+
+typedef struct sched_task sched_task_t;
+
+// now_us is when the task was run, which is on or (a little) after its deadline
+typedef void (*sched_fn_t)(sched_task_t *task, uint64_t now_us);
+
+struct sched_task {
+    sched_fn_t fn;
+    uint64_t deadline_us; // time_us_64() to run at
+    bool armed;           // if it is waiting to run
+    sched_task_t *next;   // in the list of armed tasks, soonest first
+};
+
+#define SCHED_TASK(func) { .fn = (func) }
+
+// run task at deadline_us (or as soon as possible if that has passed). if it was already armed, it is moved
+void sched_at(sched_task_t *task, uint64_t deadline_us);
+
+// run task delay_us from now
+void sched_in(sched_task_t *task, uint64_t delay_us);
+
+// don't run task after all
+void sched_cancel(sched_task_t *task);
+
+// run everything that is due, returns true if anything ran
+bool sched_run_due(void);
+
+// sleep until the next deadline, or until an interrupt if that is sooner
+void sched_wait(void);
+
+// number of times sched_wait has woken up
+uint32_t sched_wakeups(void);
+
+#endif
@@ -0,0 +1,143 @@
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+
+#include "sevenseg.h"
+
+#if SEVENSEG_PIO
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+#include "sevenseg_mux.pio.h"
+#endif
+
+// segments a-g (bits 0-6) of each digit. the 9 has no bottom segment, same as the old bits_L/bits_R
+#define DIGIT_SEGS(d) ((d) == 0 ? 0x3f : (d) == 1 ? 0x06 : (d) == 2 ? 0x5b : (d) == 3 ? 0x4f : (d) == 4 ? 0x66 : \
+    (d) == 5 ? 0x6d : (d) == 6 ? 0x7d : (d) == 7 ? 0x07 : (d) == 8 ? 0x7f : 0x67)
+
+#define DIGIT_SEG(pos, d, seg) ((DIGIT_SEGS(d) >> (seg)) & 1 ? SEVENSEG_SEGMENT(pos, seg) : 0)
+
+// digit d shown in position pos
+#define DIGIT(pos, d) (DIGIT_SEG(pos, d, SEG_A) | DIGIT_SEG(pos, d, SEG_B) | DIGIT_SEG(pos, d, SEG_C) | \
+    DIGIT_SEG(pos, d, SEG_D) | DIGIT_SEG(pos, d, SEG_E) | DIGIT_SEG(pos, d, SEG_F) | DIGIT_SEG(pos, d, SEG_G))
+
+// no leading zeros: the tens come on from 10, and the hundreds from 100 (when the tens are always on)
+#define NUMBER(h, t, u) (((h) ? DIGIT(2, 1) : 0) | ((h) || (t) ? DIGIT(1, t) : 0) | DIGIT(0, u))
+#define NUMBERS_10(h, t) NUMBER(h, t, 0), NUMBER(h, t, 1), NUMBER(h, t, 2), NUMBER(h, t, 3), NUMBER(h, t, 4), \
+    NUMBER(h, t, 5), NUMBER(h, t, 6), NUMBER(h, t, 7), NUMBER(h, t, 8), NUMBER(h, t, 9)
+#define NUMBERS_100(h) NUMBERS_10(h, 0), NUMBERS_10(h, 1), NUMBERS_10(h, 2), NUMBERS_10(h, 3), NUMBERS_10(h, 4), \
+    NUMBERS_10(h, 5), NUMBERS_10(h, 6), NUMBERS_10(h, 7), NUMBERS_10(h, 8), NUMBERS_10(h, 9)
+
+// worked out by the compiler, so a number is one lookup rather than dividing it up into digits
+static const sevenseg_mask_t numbers[200] = { NUMBERS_100(0), NUMBERS_100(1) };
+
+sevenseg_mask_t sevenseg_number(uint n) {
+    return numbers[n < 200 ? n : 199];
+}
+
+sevenseg_mask_t sevenseg_tenths(uint tenths) {
+    sevenseg_mask_t mask = sevenseg_number(tenths) | SEVENSEG_DP;
+    return tenths < 10 ? mask | DIGIT(1, 0) : mask; // 0.5 rather than .5
+}
+
+#if !SEVENSEG_MUX_DIGITS
+// every pin of the directly driven display, which are all next to each other
+#define ALL_PINS ((((1u << 14) - 1) << SEVENSEG_FIRST_GPIO) | 1u << SEVENSEG_HUNDREDS_GPIO | 1u << SEVENSEG_DP_GPIO)
+_Static_assert(SEVENSEG_HUNDREDS_GPIO + 1 == SEVENSEG_DP_GPIO && SEVENSEG_DP_GPIO + 1 == SEVENSEG_FIRST_GPIO,
+               "the PIO needs the display's gpios in one run");
+#endif
+
+#if SEVENSEG_PIO
+
+// the words the state machine goes round, one per digit (or just one when driven directly). the DMA ring
+// has to be a power of 2, so a 3 digit display has a spare slot, which is all 0 and over in a few cycles
+#if SEVENSEG_MUX_DIGITS
+#define SLOTS (SEVENSEG_MUX_DIGITS > 2 ? 4 : SEVENSEG_MUX_DIGITS)
+#define PIN_BASE SEVENSEG_MUX_FIRST_GPIO
+#define PIN_COUNT (8 + SEVENSEG_MUX_DIGITS)
+#else
+#define SLOTS 1
+#define PIN_BASE SEVENSEG_HUNDREDS_GPIO
+#define PIN_COUNT 16
+#endif
+#define RING_BITS (SLOTS == 4 ? 4 : SLOTS == 2 ? 3 : 2)
+
+// a state machine cycle every 4us, so a slot (lit for `lit` cycles, blanked for the rest of 255) is ~1ms
+#define PIO_HZ 250000
+
+static uint32_t frame[SLOTS] __attribute__((aligned(SLOTS * 4)));
+static sevenseg_mask_t shown = 0;
+static uint8_t lit = 255;
+
+// pins, then how many cycles they stay lit, then how many they are blanked for
+static uint32_t slot_word(uint32_t pins) {
+    return (lit ? pins : 0) | (uint32_t)lit << 16 | (uint32_t)(255 - lit) << 24;
+}
+
+// each word is written in one go, so a digit is never half changed. the state machine reads a new one
+// every ~1ms and the whole frame is rewritten in well under that
+static void update_frame(void) {
+#if SEVENSEG_MUX_DIGITS
+    for (int digit = 0; digit < SEVENSEG_MUX_DIGITS; digit++) {
+        uint32_t select = 1u << (8 + SEVENSEG_MUX_DIGITS - 1 - digit);
+        frame[digit] = slot_word(((shown >> (8 * digit)) & 0xff) | select);
+    }
+#else
+    frame[0] = slot_word(shown >> PIN_BASE);
+#endif
+}
+
+void sevenseg_init(void) {
+    PIO pio = pio1; // the reed switch capture has most of pio0
+    for (uint gpio = PIN_BASE; gpio < PIN_BASE + PIN_COUNT; gpio++) {
+        pio_gpio_init(pio, gpio);
+    }
+    uint offset = pio_add_program(pio, &sevenseg_mux_program);
+    uint sm = pio_claim_unused_sm(pio, true);
+    pio_sm_set_consecutive_pindirs(pio, sm, PIN_BASE, PIN_COUNT, true);
+    pio_sm_config c = sevenseg_mux_program_get_default_config(offset);
+    sm_config_set_out_pins(&c, PIN_BASE, PIN_COUNT);
+    sm_config_set_out_shift(&c, true, false, 32);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv_int_frac(&c, clock_get_hz(clk_sys) / PIO_HZ, 0);
+    pio_sm_init(pio, sm, offset, &c);
+    update_frame();
+
+    // round and round the frame. at a word every ~1ms the transfer count lasts ~50 days
+    uint chan = dma_claim_unused_channel(true);
+    dma_channel_config d = dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&d, DMA_SIZE_32);
+    channel_config_set_read_increment(&d, true);
+    channel_config_set_write_increment(&d, false);
+    channel_config_set_ring(&d, false, RING_BITS);
+    channel_config_set_dreq(&d, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(chan, &d, &pio->txf[sm], frame, 0xffffffff, true);
+
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+void sevenseg_show(sevenseg_mask_t mask) {
+    shown = mask;
+    update_frame();
+}
+
+void sevenseg_brightness(uint8_t level) {
+    lit = level;
+    update_frame();
+}
+
+#else
+
+void sevenseg_init(void) {
+    gpio_init_mask(ALL_PINS);
+    gpio_set_dir_out_masked(ALL_PINS);
+}
+
+void sevenseg_show(sevenseg_mask_t mask) {
+    gpio_put_masked(ALL_PINS, mask);
+}
+
+void sevenseg_brightness(uint8_t level) {
+    (void)level;
+}
+
+#endif
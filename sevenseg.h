@@ -0,0 +1,91 @@
+#ifndef _inc_sevenseg
+#define _inc_sevenseg
+
+#include "pico/stdlib.h"
+
+// the 7 segment display. as wired up, two digits are driven directly with a gpio per segment, plus a half
+// digit (just the 1) for 100-199 and a decimal point. a display with more digits can be multiplexed instead.
+// a PIO state machine refreshes the pins from a frame in RAM by DMA, which also does the brightness by
+// blanking them for part of each refresh, so changing what is shown is one word written and nothing else
+// runs on the CPU. SEVENSEG_PIO 0 drives the pins directly instead (no brightness, direct wiring only)
+
+#ifndef SEVENSEG_PIO
+#define SEVENSEG_PIO 1
+#endif
+
+// 0 = driven directly, as wired up. otherwise the number of digits (up to 4), sharing 8 segment lines
+// (a-g then dp) from SEVENSEG_MUX_FIRST_GPIO, followed by a select line per digit, leftmost first.
+// everything active high
+#ifndef SEVENSEG_MUX_DIGITS
+#define SEVENSEG_MUX_DIGITS 0
+#endif
+
+// direct wiring: the 14 segments of the two digits from SEVENSEG_FIRST_GPIO (interleaved, see
+// SEVENSEG_UNITS_BIT and SEVENSEG_TENS_BIT), with the hundreds and the decimal point just before
+#define SEVENSEG_FIRST_GPIO 8
+#define SEVENSEG_HUNDREDS_GPIO 6 // both segments of the 1
+#define SEVENSEG_DP_GPIO 7       // decimal point after the tens digit
+
+#define SEVENSEG_MUX_FIRST_GPIO 6
+
+// every gpio the display drives, whichever way it is wired (the direct wiring's 16 are one run from 6 to 21),
+// so nothing else gets put on one of them
+#if SEVENSEG_MUX_DIGITS
+#define SEVENSEG_GPIOS (((1u << (8 + SEVENSEG_MUX_DIGITS)) - 1) << SEVENSEG_MUX_FIRST_GPIO)
+#else
+#define SEVENSEG_GPIOS (((1u << 16) - 1) << SEVENSEG_HUNDREDS_GPIO)
+#endif
+
+typedef enum { SEG_A, SEG_B, SEG_C, SEG_D, SEG_E, SEG_F, SEG_G, SEG_DP } sevenseg_segment_t;
+
+// segments to light: the gpios themselves when driven directly, otherwise a byte per digit, units first
+typedef uint32_t sevenseg_mask_t;
+
+#if SEVENSEG_MUX_DIGITS
+
+#if SEVENSEG_MUX_DIGITS > 4
+#error "SEVENSEG_MUX_DIGITS can be up to 4"
+#endif
+#if !SEVENSEG_PIO
+#error "a multiplexed display needs the PIO to refresh it"
+#endif
+
+// digit 0 is the units
+#define SEVENSEG_SEGMENT(digit, seg) (1u << (8 * (digit) + (seg)))
+
+#else
+
+// which bit past SEVENSEG_FIRST_GPIO each segment of the digits is wired to
+#define SEVENSEG_UNITS_BIT(seg) ((seg) == SEG_A ? 1 : (seg) == SEG_B ? 0 : (seg) == SEG_C ? 13 : \
+    (seg) == SEG_D ? 12 : (seg) == SEG_E ? 11 : (seg) == SEG_F ? 2 : 3)
+#define SEVENSEG_TENS_BIT(seg) ((seg) == SEG_A ? 5 : (seg) == SEG_B ? 4 : (seg) == SEG_C ? 10 : \
+    (seg) == SEG_D ? 9 : (seg) == SEG_E ? 8 : (seg) == SEG_F ? 6 : 7)
+
+// digit 0 is the units, 1 the tens (the only one with a decimal point) and 2 the hundreds (only b and c)
+#define SEVENSEG_SEGMENT(digit, seg) \
+    ((seg) == SEG_DP ? ((digit) == 1 ? 1u << SEVENSEG_DP_GPIO : 0) : \
+     (digit) == 0 ? 1u << (SEVENSEG_FIRST_GPIO + SEVENSEG_UNITS_BIT(seg)) : \
+     (digit) == 1 ? 1u << (SEVENSEG_FIRST_GPIO + SEVENSEG_TENS_BIT(seg)) : \
+     ((seg) == SEG_B || (seg) == SEG_C) ? 1u << SEVENSEG_HUNDREDS_GPIO : 0)
+
+#endif
+
+#define SEVENSEG_DASH SEVENSEG_SEGMENT(0, SEG_G)
+#define SEVENSEG_DP SEVENSEG_SEGMENT(1, SEG_DP)
+
+// set up the gpios (and the PIO), showing nothing
+void sevenseg_init(void);
+
+// change what is shown, all at once so nothing flickers
+void sevenseg_show(sevenseg_mask_t mask);
+
+// 0 (off) to 255 (full). only with SEVENSEG_PIO, otherwise it is always full
+void sevenseg_brightness(uint8_t level);
+
+// n (0-199, anything more shows 199) with no leading zeros, from a table
+sevenseg_mask_t sevenseg_number(uint n);
+
+// n/10 with the decimal point, e.g. 95 is 9.5 (up to 19.9)
+sevenseg_mask_t sevenseg_tenths(uint tenths);
+
+#endif
@@ -2,74 +2,344 @@
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
 
-#include "hardware/i2c.h"
-// from https://github.com/daschr/pico-ssd1306 (owner doesn't have a proper way to add project, instructs to just copy files in manually)
-#include "extern/pico-ssd1306/src/ssd1306.h"
+#include "display.h"
+#include "reed.h"
+#include "edge_filter.h"
+#include "instr.h"
+#include "ride_log.h"
+#include "ride_stats.h"
+#include "sched.h"
+#include "sevenseg.h"
+#include "speed.h"
+#include "telemetry.h"
+
+// the sensors, each a reed switch on its own channel (see reed.h)
+#define WHEEL_CHANNEL 0
+#define WHEEL_GPIO 22
+#define CADENCE_CHANNEL 1
+#define CADENCE_GPIO 26
+_Static_assert(!(SEVENSEG_GPIOS & (1u << WHEEL_GPIO | 1u << CADENCE_GPIO)),
+               "a reed switch is on one of the 7 segment display's gpios");
+
+// the cadence goes to 0 this long after the cranks last went round (20 rpm)
+#define CADENCE_STOPPED_AFTER_US 3000000
+
+// how long the onboard led lights up for each revolution
+#define LED_PULSE_US 50000
 
-#define REED_GPIO 22
-#define SEG_FIRST_GPIO 8
+#define ANIMATION_WELCOME_BACK_DELAY 40
 
-#define WHEEL_CIRCUMFERENCE 2.231
+// the 7 segment display goes to 0 once a revolution is taking longer than this, and the ride is over after
+// this long. with several magnets on the wheel that is noticed as soon as the next one is late (see edge_filter_due_us)
+#define ZERO_AFTER_US 5000000
+#define STOPPED_AFTER_US EDGE_FILTER_STOPPED_AFTER_US
 
-#define VELOCITY_CONSTANT (WHEEL_CIRCUMFERENCE*60*60)
+// how soon to try again if the OLED was still busy with the last frame
+#define OLED_RETRY_US 2000
 
-#define ANIMATION_WELCOME_BACK_DELAY 40
+// once the ride is over, the OLED is dimmed after this long and switched off after this long
+#define OLED_DIM_AFTER_US 30000000
+#define OLED_OFF_AFTER_US 300000000
 
-#define DISPLAY_I2C i2c0
-#define DISPLAY_I2C_SCL 5
-#define DISPLAY_I2C_SDA 4
-
-// define characters for each segment
-const int bits_L[10] = {
-    0b00011101110000,
-    0b00010000010000,
-    0b00001110110000,
-    0b00011010110000,
-    0b00010011010000,
-    0b00011011100000,
-    0b00011111100000,
-    0b00010000110000,
-    0b00011111110000,
-    0b00010011110000,
-};
-const int bits_R[10] = {
-    0b11100000000111,
-    0b10000000000001,
-    0b01100000001011,
-    0b11000000001011,
-    0b10000000001101,
-    0b11000000001110,
-    0b11100000001110,
-    0b10000000000011,
-    0b11100000001111,
-    0b10000000001111,
-};
+// the resting dash on the 7 segment display doesn't draw enough current to stop the power bank switching
+// itself off, so it lights up a 0 for a moment every so often
+#define KEEPALIVE_EVERY_US 20000000
+#define KEEPALIVE_PULSE_US 500000
+
+// and the 7 segment display goes down to this (of 255) along with the OLED, apart from the keepalive 0,
+// which is only there to draw current so goes out at full
+#define SEVENSEG_DIM_LEVEL 48
+
+// the human readable log, unless stdio is carrying binary telemetry instead
+#if SPEDO_TELEMETRY
+#define log_printf(...)
+#else
+#define log_printf(...) printf(__VA_ARGS__)
+#endif
 
 const uint LED_PIN = 25;
 
-void draw_oled(ssd1306_t disp, int dist, int mins_all, int mins_moving, int av_speed, int max_speed, int curr_speed_miles) {
-    char str[20];
-    ssd1306_clear(&disp);
-    sprintf(str, "%d", dist);
-    ssd1306_draw_string(&disp, 0, 0, 1, str);
-    ssd1306_draw_string(&disp, 50, 0, 1, "metres");
-    sprintf(str, "%d", mins_all);
-    ssd1306_draw_string(&disp, 0, 10, 1, str);
-    ssd1306_draw_string(&disp, 50, 10, 1, "minutes,");
-    sprintf(str, "%d", mins_moving);
-    ssd1306_draw_string(&disp, 0, 20, 1, str);
-    ssd1306_draw_string(&disp, 50, 20, 1, "moving");
-    sprintf(str, "%d", av_speed);
-    ssd1306_draw_string(&disp, 0, 30, 1, str);
-    ssd1306_draw_string(&disp, 50, 30, 1, "km/h avg.");
-    sprintf(str, "%d", max_speed);
-    ssd1306_draw_string(&disp, 0, 40, 1, str);
-    ssd1306_draw_string(&disp, 50, 40, 1, "km/h max.");
-    ssd1306_draw_string(&disp, 0, 50, 2, "km/h");
-    sprintf(str, "%d", curr_speed_miles);
-    ssd1306_draw_string(&disp, 80, 57, 1, str);
-    ssd1306_draw_string(&disp, 105, 57, 1, "mph");
-    ssd1306_show(&disp);
+// how the reed switch edges are debounced and the speed smoothed (see edge_filter.h)
+static const edge_filter_config_t filter_config = EDGE_FILTER_CONFIG_SPEDO;
+
+// and the crank magnet's. cadence is only shown in whole rpm, and a rider changes it gradually, so a plain
+// average over a few turns of the cranks is plenty
+static const edge_filter_config_t cadence_config = {
+    .settle_us = 2000,
+    .holdoff_us = 5000,
+    .magnets = 1,
+    .type = SPEED_FILTER_MOVING_AVERAGE,
+    .window = 3,
+};
+
+// RIDE STATE ------------------------------------------------------------------
+
+static int state = 3; // 0 = moving, 3 = stationary (states 1 and 2 were flashing the led and waiting for the magnet to go past)
+static edge_filter_t filter; // revolutions and speed from the reed switch edges
+static ride_stats_t ride; // distance, moving time, speeds and splits since power on
+static edge_filter_t cadence; // crank revolutions from the cadence sensor's edges
+
+static int animation_frame = -1; // how far through the welcome back animation, -1 when it isn't running
+static uint64_t oled_edge_us = 0; // the reed switch edge the next snapshot is showing the speed from, see instr.h
+static bool keepalive_lit = false; // if the 7 segment display is showing the keep alive 0
+static display_power_t oled_power = DISPLAY_BRIGHT;
+
+// TASKS -----------------------------------------------------------------------
+
+static void oled_task(sched_task_t *task, uint64_t now) {
+    (void)now;
+    if (display_poll()) {
+        sched_in(task, OLED_RETRY_US);
+    }
+}
+static sched_task_t oled = SCHED_TASK(oled_task);
+
+// publish the current stats to the OLED
+static void show_oled(uint64_t now) {
+    int all_time = now / 1000000;
+    ride_snapshot_t snap = {
+        .dist = ride.dist_mm / 1000,
+        .mins_all = all_time/60,
+        .mins_moving = ride_stats_moving_s(&ride)/60,
+        .av_speed = speed_kmh(ride_stats_average(&ride)),
+        .max_speed = speed_kmh(ride.max_speed),
+        .curr_speed_miles = speed_kmh(speed_to_mph(filter.speed)),
+        .cadence = edge_filter_rpm(&cadence),
+        .wheel_frame = animation_frame > 0 ? animation_frame : 0, // the frame the 7 segment display is on
+        .edge_us = oled_edge_us,
+        .power = oled_power,
+    };
+    oled_edge_us = 0;
+    if (display_update(&snap)) {
+        sched_in(&oled, OLED_RETRY_US);
+    }
+}
+
+// publish the current stats to the OLED and telemetry
+static void show_stats(uint64_t now) {
+    show_oled(now);
+
+    telemetry_stats_t stats = {
+        .dist_mm = ride.dist_mm,
+        .all_time_s = now / 1000000,
+        .moving_time_s = ride_stats_moving_s(&ride),
+        .speed = filter.speed,
+        .accel = filter.accel_q8,
+        .max_speed = ride.max_speed,
+        .av_speed = ride_stats_average(&ride),
+        .revs = ride.revs,
+        .dropped_edges = reed_dropped_edges(),
+        .cadence = edge_filter_rpm(&cadence),
+    };
+    telemetry_stats(now, &stats);
+}
+
+// the time counters go up on the OLED once a second while moving. while stationary only the minutes
+// since power on change, so it just wakes up on the minute (and not at all once the OLED is off)
+static void stats_task(sched_task_t *task, uint64_t now) {
+    show_stats(now);
+    if (state == 0) {
+        sched_at(task, task->deadline_us + 1000000); // from the deadline rather than now, so it doesn't drift
+    } else if (oled_power != DISPLAY_OFF) {
+        sched_at(task, (now / 60000000 + 1) * 60000000);
+    }
+}
+static sched_task_t stats = SCHED_TASK(stats_task);
+
+static void led_task(sched_task_t *task, uint64_t now) {
+    (void)task;
+    (void)now;
+    gpio_put(LED_PIN, 0);
+}
+static sched_task_t led = SCHED_TASK(led_task);
+
+// the spinner on the 7 segment display, with the wheel on the OLED going round in step with it
+static void animation_task(sched_task_t *task, uint64_t now) {
+    static const sevenseg_mask_t segs[8] = {
+        SEVENSEG_SEGMENT(0, SEG_B),
+        SEVENSEG_SEGMENT(0, SEG_A),
+        SEVENSEG_SEGMENT(1, SEG_A),
+        SEVENSEG_SEGMENT(1, SEG_F),
+        SEVENSEG_SEGMENT(1, SEG_E),
+        SEVENSEG_SEGMENT(1, SEG_D),
+        SEVENSEG_SEGMENT(0, SEG_D),
+        SEVENSEG_SEGMENT(0, SEG_C),
+    }; // circular animation
+    if (animation_frame < 8) {
+        sevenseg_show(segs[animation_frame++]);
+        sched_at(task, task->deadline_us + ANIMATION_WELCOME_BACK_DELAY * 1000);
+    } else {
+        // set to an initial zero
+        sevenseg_show(sevenseg_number(0));
+        animation_frame = -1;
+    }
+    show_oled(now);
+}
+static sched_task_t animation = SCHED_TASK(animation_task);
+
+// effectively stationary - turn display to zero
+static void zero_task(sched_task_t *task, uint64_t now) {
+    (void)task;
+    (void)now;
+    sevenseg_show(sevenseg_number(0)); // set to zero rather than a dash because it needs to be consuming enough power for power bank to not turn off!
+    log_printf("0 km/h = 0 mph | %d m\n", (int)(ride.dist_mm / 1000));
+}
+static sched_task_t zero = SCHED_TASK(zero_task);
+
+// left for a while, turn the OLED and the 7 segment display down
+static void dim_task(sched_task_t *task, uint64_t now) {
+    (void)task;
+    oled_power = DISPLAY_DIM;
+    show_stats(now);
+    sevenseg_brightness(SEVENSEG_DIM_LEVEL);
+}
+static sched_task_t dim = SCHED_TASK(dim_task);
+
+// left for even longer, turn the OLED off. nothing changes on it now, so stop updating it too
+static void oled_off_task(sched_task_t *task, uint64_t now) {
+    (void)task;
+    oled_power = DISPLAY_OFF;
+    show_stats(now);
+    sched_cancel(&stats);
+}
+static sched_task_t oled_off = SCHED_TASK(oled_off_task);
+
+// flash up the 0 to keep the power bank on, then back to the dash
+static void keepalive_task(sched_task_t *task, uint64_t now) {
+    (void)now;
+    keepalive_lit = !keepalive_lit;
+    sevenseg_brightness(keepalive_lit || oled_power == DISPLAY_BRIGHT ? 255 : SEVENSEG_DIM_LEVEL);
+    sevenseg_show(keepalive_lit ? sevenseg_number(0) : SEVENSEG_DASH);
+    sched_at(task, task->deadline_us + (keepalive_lit ? KEEPALIVE_PULSE_US : KEEPALIVE_EVERY_US - KEEPALIVE_PULSE_US));
+}
+static sched_task_t keepalive = SCHED_TASK(keepalive_task);
+
+// the display settles down into its resting state, with the OLED going dim then off
+static void rest(uint64_t now) {
+    sevenseg_show(SEVENSEG_DASH);
+    keepalive_lit = false;
+    sched_at(&keepalive, now + KEEPALIVE_EVERY_US - KEEPALIVE_PULSE_US);
+    sched_at(&dim, now + OLED_DIM_AFTER_US);
+    sched_at(&oled_off, now + OLED_OFF_AFTER_US);
+}
+
+// effectively stationary - the ride is over, turn display off
+static void stop_task(sched_task_t *task, uint64_t now) {
+    (void)task;
+    sched_cancel(&animation);
+    animation_frame = -1;
+    rest(now);
+    state = 3;
+    edge_filter_stop(&filter);
+    ride_log_stop(now / 1000);
+    log_printf("----- STOPPED -----\n");
+#if !SPEDO_TELEMETRY // only for the log, which telemetry compiles out
+    uint32_t best_1km = ride_stats_best_split_ms(&ride, RIDE_STATS_SPLIT_1KM);
+    log_printf("median %d km/h, 90%% under %d km/h | best 1 km %d:%02d\n",
+               speed_kmh(ride_stats_percentile(&ride, 50)), speed_kmh(ride_stats_percentile(&ride, 90)),
+               (int)(best_1km / 60000), (int)(best_1km / 1000 % 60));
+#endif
+}
+static sched_task_t stop = SCHED_TASK(stop_task);
+
+// stopped pedalling
+static void cadence_stop_task(sched_task_t *task, uint64_t now) {
+    (void)task;
+    edge_filter_stop(&cadence);
+    show_oled(now);
+}
+static sched_task_t cadence_stop = SCHED_TASK(cadence_stop_task);
+
+// EVENTS ----------------------------------------------------------------------
+
+// take the next captured reed switch edge, and send it out as telemetry
+static bool next_edge(reed_edge_t *edge) {
+    if (!reed_pop_edge(edge)) {
+        return false;
+    }
+    INSTR_RECORD(INSTR_EDGE, time_us_64() - edge->time_us);
+    telemetry_edge(edge);
+    return true;
+}
+
+// the wheel has started going round again, the next revolution is timed from here
+static void start(void) {
+    state = 0;
+    ride_log_start(filter.rev_us / 1000);
+
+    // wake the OLED back up, and the time counters go up every second again
+    sched_cancel(&keepalive);
+    sched_cancel(&dim);
+    sched_cancel(&oled_off);
+    oled_power = DISPLAY_BRIGHT;
+    show_stats(filter.rev_us);
+    sevenseg_brightness(255);
+    sched_at(&stats, (filter.rev_us / 1000000 + 1) * 1000000);
+
+    // show welcome back message
+    log_printf("----- STARTING -----\n");
+
+    // show animation!
+    animation_frame = 0;
+    sched_at(&animation, filter.rev_us);
+
+    sched_at(&zero, edge_filter_due_us(&filter, ZERO_AFTER_US));
+    sched_at(&stop, edge_filter_due_us(&filter, STOPPED_AFTER_US));
+}
+
+// the wheel has gone round again (or the next magnet has gone past)
+static void revolution(void) {
+    speed_q8_t v_q8 = filter.speed;
+    int v = speed_kmh(v_q8); // velocity in km/h
+    ride_log_revolution(filter.interval_us);
+    ride_stats_revolution(&ride, filter.arc_q16, filter.interval_us, v_q8);
+    log_printf("%d km/h = %d mph | %d m\n", v, speed_kmh(speed_to_mph(v_q8)), (int)(ride.dist_mm / 1000));
+
+    // new speed on the 7 segment display (to a tenth under 10 km/h), unless it is still showing the animation
+    if (animation_frame < 0) {
+        sevenseg_show(v < 10 ? sevenseg_tenths(speed_kmh_tenths(v_q8)) : sevenseg_number(v));
+    }
+
+    oled_edge_us = filter.rev_us;
+    show_stats(filter.rev_us);
+
+    // flash the onboard led, once a revolution
+    if (filter.magnet == 0) {
+        gpio_put(LED_PIN, 1);
+        sched_at(&led, filter.rev_us + LED_PULSE_US);
+    }
+
+    sched_at(&zero, edge_filter_due_us(&filter, ZERO_AFTER_US));
+    sched_at(&stop, edge_filter_due_us(&filter, STOPPED_AFTER_US));
+}
+
+// the cranks have gone round again. the cadence isn't worth waking the OLED up for on its own, but while it is
+// on it gets the new number
+static void cadence_revolution(edge_filter_event_t ev) {
+    if (ev == EDGE_FILTER_REV && oled_power != DISPLAY_OFF) {
+        show_oled(cadence.rev_us);
+    }
+    sched_at(&cadence_stop, edge_filter_due_us(&cadence, CADENCE_STOPPED_AFTER_US));
+}
+
+// writing the ride log to flash holds off interrupts and the mainloop while it runs. the PIO still timestamps
+// the edges, but working out the speed from them has to wait (and with REED_PIO 0 the timestamps are late too).
+// so only do it while stationary, or after the magnet has gone past if the next revolution is far enough off.
+// returns true if it did anything
+static bool service_ride_log(void) {
+    if (state == 3) {
+        return ride_log_service(UINT32_MAX);
+    }
+    if (filter.closed) {
+        return false;
+    }
+    // allow for speeding up by a quarter
+    uint64_t next_rev_us = filter.rev_us + filter.interval_us * 3 / 4;
+    uint64_t now = time_us_64();
+    if (next_rev_us <= now) {
+        return false;
+    }
+    return ride_log_service(next_rev_us - now > UINT32_MAX ? UINT32_MAX : (uint32_t)(next_rev_us - now));
 }
 
 int main() {
@@ -79,179 +349,69 @@ int main() {
     // init serial connection
     stdio_init_all();
 
-    // init OLED
-    i2c_init(DISPLAY_I2C, 400000);
-    gpio_set_function(DISPLAY_I2C_SCL, GPIO_FUNC_I2C);
-    gpio_set_function(DISPLAY_I2C_SDA, GPIO_FUNC_I2C);
-    gpio_pull_up(DISPLAY_I2C_SCL);
-    gpio_pull_up(DISPLAY_I2C_SDA);
-
-    ssd1306_t disp;
-    disp.external_vcc=false;
-    ssd1306_init(&disp, 128, 64, 0x3C, DISPLAY_I2C);
-
-    // Show test screen
-    draw_oled(disp, 0, 0, 0, 0, 0, 0);
+    // init OLED (on core1 if it is rendered there) and show test screen
+    display_init();
 
     // init rev indicator LED
     gpio_init(LED_PIN);
     gpio_set_dir(LED_PIN, GPIO_OUT);
 
-    // init reed switch gpio as a button
-    gpio_init(REED_GPIO);
-    gpio_set_dir(REED_GPIO, GPIO_IN);
-    gpio_pull_up(REED_GPIO);
+    // init the reed switches, edges are timestamped in the background and queued up for the mainloop
+    reed_init(WHEEL_CHANNEL, WHEEL_GPIO, REED_PIO_DEBOUNCE_US);
+    reed_init(CADENCE_CHANNEL, CADENCE_GPIO, REED_PIO_DEBOUNCE_US);
+    edge_filter_init(&filter, &filter_config);
+    edge_filter_init(&cadence, &cadence_config);
+    ride_stats_init(&ride);
+
+    // carry on the ride log from where it got to before power off
+    ride_log_init();
 
     // init 7 seg gpios
-    for (int gpio = SEG_FIRST_GPIO; gpio < SEG_FIRST_GPIO + 14; gpio++) {
-        gpio_init(gpio);
-        gpio_set_dir(gpio, GPIO_OUT);
-    }
+    sevenseg_init();
 
     // set initial segments to single dash (normal resting state)
-    int32_t mask;
-    mask = 0b1000 << SEG_FIRST_GPIO;
-    gpio_set_mask(mask);
+    rest(time_us_64());
 
-    // INIT MAINLOOP ---------------------------------------------------------------
+    // MAINLOOP --------------------------------------------------------------------
 
-    int t = 0; // time in milliseconds since last complete revolution of the wheel
-    int state = 3; // internal state used to determine if moving or not etc...
-    float dist = 0; // distance in meters
+    sched_at(&stats, time_us_64() + 1000000);
 
-    int max_v = 0; // highest speed reached since power on
-
-    int time = 0; // current time tracker (like t, but never reset)
-    int all_time = 0; // time in seconds since power on
-    int moving_time = 1; // time in seconds that have been in motion (init to 1 to prevent /0 errors, still appears as 0mins on display)
-
-    int mph = 0; // used only to store current speed for the conversion so can be used in optimised rendering times
-
-    absolute_time_t prev_loop_iter_time_usec = get_absolute_time();
+    int reported_state = state; // last state sent as telemetry
+    reed_edge_t edge; // edge most recently taken from the reed capture buffer
 
     while (1) {
-        // account for if took over 1 millisecond for prev loop cycle
-        while (absolute_time_diff_us(prev_loop_iter_time_usec, get_absolute_time()) > 1000) {
-            t++;
-            time++;
-            prev_loop_iter_time_usec = delayed_by_ms(prev_loop_iter_time_usec,1);
-        }
-        // make sure exactly 1 millisecond has elapsed since timers were last incremented
-        sleep_until(delayed_by_ms(prev_loop_iter_time_usec,1)); // sleep for up to 1ms
-        prev_loop_iter_time_usec = get_absolute_time();  // start timer for next cycle of the mainloop
-        // increment the timers
-        t++;
-        time++;
-        // update time counters
-        if (time > 1000) { 
-            // then it must have been at least 1 second since last updated - so add 1 second to counters
-            time -= 1000; // subtract in case it is like 1.05 seconds (for accuracy)
-            all_time++;
-            if (state < 3) {
-                // only update if moving
-                moving_time++;
-            }
-            // only update OLED every so often, since it takes a little while to update it it slows down the mainloop considerably if updated every 'millisecond'
-            draw_oled(disp, (int)dist, (int)(all_time/60), (int)(moving_time/60), (int) (3.6*(dist / moving_time)), max_v, mph);
-        }
-
-        if (state == 0) { // reed-open state
-            if (!gpio_get(REED_GPIO)){ // reed closed
-                state = 1; 
-                // this is kinda now a state 0.5 (only run when entering state 1 from 0)
-
-                // set the speed based on params
-                int v = VELOCITY_CONSTANT / t; // velocity in km/h
-                dist += WHEEL_CIRCUMFERENCE; // add distance to the log
-                printf("%d km/h = %d mph | %d m\n", v, (int) (v*0.62), (int)dist);
-            
-                // remove previous display, set new mask, and display
-                gpio_clr_mask(mask);
-                if (v >= 10) {
-                    mask = (bits_L[v/10] | bits_R[v%10]) << SEG_FIRST_GPIO;
-                } else {
-                    mask = bits_R[v%10] << SEG_FIRST_GPIO;
+        bool busy = false;
+        while (next_edge(&edge)) {
+            if (edge.channel == CADENCE_CHANNEL) {
+                edge_filter_event_t ev = edge_filter_push(&cadence, &edge);
+                if (ev != EDGE_FILTER_NONE) {
+                    cadence_revolution(ev);
                 }
-                gpio_set_mask(mask);
-
-                if (v > max_v) {
-                    max_v = v;
-                }
-
-                mph = (int) (v*0.62);
-                draw_oled(disp, (int)dist, (int)(all_time/60), (int)(moving_time/60), (int) (3.6*(dist / moving_time)), max_v, mph);
-
-                // reset time
-                t = 0;
-            } 
-            // else stay in current state
-            if (t == 5000) { // effectively stationary - turn display to dashes
-                // remove previous display, set new mask, and display
-                gpio_clr_mask(mask);
-                mask = bits_R[0] << SEG_FIRST_GPIO; // 0b10001000 for dashes -- set to zero because it needs to be consuming enough power for power bank to not turn off!
-                gpio_set_mask(mask);
-                printf("0 km/h = 0 mph | %d m\n", (int)dist);
+                continue;
             }
-            if (t > 10000) { // effectively stationary - turn display off
-                // remove previous display, set new mask, and display
-                gpio_clr_mask(mask);
-                mask = 0b1000 << SEG_FIRST_GPIO;
-                gpio_set_mask(mask);
-                state = 3;
-                mph = 0;
-                printf("----- STOPPED -----\n");
+            edge_filter_event_t ev = edge_filter_push(&filter, &edge);
+            if (ev == EDGE_FILTER_START) {
+                start();
+            } else if (ev == EDGE_FILTER_REV) {
+                revolution();
             }
         }
-        if (state == 1) { // in reed-closed state
-            // flash the onboard led for 50ms, add that to the timer
-            gpio_put(LED_PIN, 1);
-            sleep_ms(50);
-            t += 50;
-            time += 50;
-            gpio_put(LED_PIN, 0);
-            state = 2;
-        }
-        if (state == 2) { // trying to leave reed-closed state
-            // check constantly to see when the passing of the magnet is over
-            if (!gpio_get(REED_GPIO)){ // reed closed
-                state = 1;
-            } else { // reed open
-                state = 0;
-            }
+
+        busy |= sched_run_due();
+
+        if (state != reported_state) {
+            telemetry_state(time_us_64(), state);
+            reported_state = state;
         }
-        if (state == 3) { // stationary reed-open state
-            // do nothing, unless starting up again:
-            if (!gpio_get(REED_GPIO)){ // reed closed
-                state = 1; 
-                // show welcome back message
-                printf("----- STARTING -----\n");
-            
-                // show animation!
-                int segs[8] = { 
-                    0b1,
-                    0b10,
-                    0b100000,
-                    0b1000000,
-                    0b100000000,
-                    0b1000000000,
-                    0b1000000000000,
-                    0b10000000000000
-                }; // circular animation
-                for (int x = 0; x < 8; x++) {
-                    gpio_clr_mask(mask);
-                    mask = segs[x] << SEG_FIRST_GPIO;
-                    gpio_set_mask(mask);
-                    sleep_ms(ANIMATION_WELCOME_BACK_DELAY);
-                }
-                // set to an initial zero
-                gpio_clr_mask(mask);
-                mask = bits_R[0] << SEG_FIRST_GPIO;
-                gpio_set_mask(mask);
-
-                // reset time
-                t = ANIMATION_WELCOME_BACK_DELAY*8;
-                time += ANIMATION_WELCOME_BACK_DELAY*8; // don't reset this one!
-            } 
+
+        busy |= service_ride_log();
+
+        // 'i' on the USB serial port dumps the instrumentation
+        INSTR_POLL(time_us_64());
+
+        // sleep until the next task is due or a reed switch edge comes in
+        if (!busy) {
+            sched_wait();
         }
     }
-}
\ No newline at end of file
+}
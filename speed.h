@@ -0,0 +1,78 @@
+#ifndef _inc_speed
+#define _inc_speed
+
+#include "pico/stdlib.h"
+
+// speed and distance maths, all in integers - the RP2040 has no FPU so every float operation is a
+// slow library call, but it does have a hardware divider so a 32 bit integer divide is only a few cycles.
+// the constants are worked out from WHEEL_CIRCUMFERENCE by the compiler, so no floats are left at runtime
+
+#define WHEEL_CIRCUMFERENCE 2.231 // in meters
+
+#define WHEEL_CIRCUMFERENCE_MM ((uint32_t)(WHEEL_CIRCUMFERENCE*1000 + 0.5))
+
+// magnets on the wheel, spaced equally round it (near enough - edge_filter learns how far apart they
+// really are). the speed, distance and stopping all update as each one goes past, rather than once a
+// revolution, which matters at walking pace where a revolution takes ~2s
+#ifndef WHEEL_MAGNETS
+#define WHEEL_MAGNETS 1
+#endif
+
+// part of a revolution, in 1/65536ths. a magnet goes past every REV_ARC / WHEEL_MAGNETS of one
+#define REV_ARC 65536u
+
+// speeds are km/h in fixed point with 8 fractional bits (1/256 km/h), so sub-km/h precision is there if wanted
+#define SPEED_FRAC_BITS 8
+typedef uint32_t speed_q8_t;
+
+// a wheel revolution taking interval_us is WHEEL_CIRCUMFERENCE_MM*3600/interval_us km/h
+// (mm per us is km per second... times 3600 for per hour)
+#define VELOCITY_CONSTANT_Q8 (WHEEL_CIRCUMFERENCE_MM*3600u << SPEED_FRAC_BITS)
+_Static_assert(WHEEL_CIRCUMFERENCE_MM < (0xFFFFFFFFu >> SPEED_FRAC_BITS) / 3600u, "VELOCITY_CONSTANT_Q8 doesn't fit in 32 bits");
+
+#define MPH_PER_KMH 0.62
+#define MPH_PER_KMH_Q32 ((uint32_t)(MPH_PER_KMH*4294967296.0 + 0.5)) // a speed times it still fits in 64 bits
+
+// speed in km/h (Q8) of one wheel revolution that took interval_us
+static inline speed_q8_t speed_from_interval_us(uint64_t interval_us) {
+    if (interval_us > 0xFFFFFFFFu) {
+        return 0; // over an hour for one revolution, may as well be stopped
+    }
+    if (interval_us == 0) {
+        return 0xFFFFFFFFu;
+    }
+    return VELOCITY_CONSTANT_Q8 / (uint32_t)interval_us;
+}
+
+// speed in km/h (Q8) of the wheel going arc (of REV_ARC) round in interval_us
+static inline speed_q8_t speed_from_arc_us(uint32_t arc, uint64_t interval_us) {
+    if (arc == 0) {
+        return 0;
+    }
+    return speed_from_interval_us(interval_us * REV_ARC / arc);
+}
+
+// whole km/h, rounded down (like the old integer speeds)
+static inline int speed_kmh(speed_q8_t v) {
+    return v >> SPEED_FRAC_BITS;
+}
+
+// tenths of a km/h, rounded down
+static inline int speed_kmh_tenths(speed_q8_t v) {
+    return (v * 10u) >> SPEED_FRAC_BITS;
+}
+
+static inline speed_q8_t speed_to_mph(speed_q8_t v) {
+    return ((uint64_t)v * MPH_PER_KMH_Q32) >> 32;
+}
+
+// average speed over a distance in mm covered in the given number of seconds
+static inline speed_q8_t speed_average(uint32_t dist_mm, uint32_t secs) {
+    if (secs == 0) {
+        return 0;
+    }
+    // mm/s to km/h is *0.0036, which is 0.9216 = 576/625 in Q8
+    return (dist_mm / secs) * 576u / 625u;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "sprite.h"
+
+#include <string.h>
+
+// reads the bytes of a frame (or mask) in order, undoing the RLE if there is any
+typedef struct {
+    const uint8_t *src;
+    uint32_t left;   // bytes left in this run
+    bool repeat;     // the run is one byte repeated, rather than bytes as they are
+    bool rle;
+} reader_t;
+
+static void reader_init(reader_t *r, const sprite_t *s, uint32_t offset) {
+    r->src = s->data + offset;
+    r->left = 0;
+    r->repeat = false;
+    r->rle = s->flags & SPRITE_RLE;
+}
+
+static inline uint8_t reader_next(reader_t *r) {
+    if (!r->rle) {
+        return *r->src++;
+    }
+    if (!r->left) {
+        uint8_t n = *r->src++;
+        r->repeat = n >= 0x80;
+        r->left = r->repeat ? n - 0x80 + 3 : n + 1;
+    }
+    r->left--;
+    if (r->repeat) {
+        return r->left ? *r->src : *r->src++;
+    }
+    return *r->src++;
+}
+
+void sprite_draw(ssd1306_t *disp, const sprite_t *s, uint frame, int x, int page) {
+    if (frame >= s->frames) {
+        return;
+    }
+    bool masked = s->flags & SPRITE_MASK;
+    const uint32_t *offsets = s->offsets + (masked ? 2 * frame : frame);
+
+    // the columns that are on the display
+    int first = x < 0 ? -x : 0;
+    int last = x + s->width > disp->width ? disp->width - x : s->width;
+
+    if (!(s->flags & SPRITE_RLE)) {
+        // as it is, so only the bytes that are on the display need reading: a memcpy per page, or with a mask
+        // only the pixels it sets
+        const uint8_t *src = s->data + offsets[0];
+        const uint8_t *mask = s->data + offsets[masked ? 1 : 0];
+        for (int p = 0; p < s->pages; p++, src += s->width, mask += s->width) {
+            if (page + p < 0 || page + p >= disp->pages || first >= last) {
+                continue;
+            }
+            uint8_t *row = disp->buffer + (page + p) * disp->width + x;
+            if (!masked) {
+                memcpy(row + first, src + first, last - first);
+                continue;
+            }
+            for (int col = first; col < last; col++) {
+                row[col] = (row[col] & ~mask[col]) | (src[col] & mask[col]);
+            }
+        }
+        return;
+    }
+
+    // every byte has to be read to get to the next, even the ones that are off the display
+    reader_t pixels, mask;
+    reader_init(&pixels, s, offsets[0]);
+    if (masked) {
+        reader_init(&mask, s, offsets[1]);
+    }
+    for (int p = 0; p < s->pages; p++) {
+        uint8_t *row = page + p >= 0 && page + p < disp->pages ? disp->buffer + (page + p) * disp->width : NULL;
+        for (int col = 0; col < s->width; col++) {
+            uint8_t b = reader_next(&pixels);
+            uint8_t m = masked ? reader_next(&mask) : 0xff;
+            if (row && col >= first && col < last) {
+                row[x + col] = (row[x + col] & ~m) | (b & m);
+            }
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef _inc_sprite
+#define _inc_sprite
+
+#include "pico/stdlib.h"
+
+#include "extern/pico-ssd1306/src/ssd1306.h"
+
+// pictures and animations for the OLED, converted from BMPs at build time by tools/sprites.py (into
+// sprites.h). they are stored the way the SSD1306 stores its pixels, so drawing one is copying page bytes
+// into the buffer, and they are read straight out of flash as they are drawn - nothing is copied into RAM
+//
+// each frame is `pages` rows of `width` bytes, the top row first, each byte a column of 8 pixels with bit 0
+// at the top. with SPRITE_MASK every frame is followed by its mask, laid out the same, which is set where
+// the sprite is drawn (elsewhere whatever is already in the buffer shows through). with SPRITE_RLE each of
+// those is run length encoded: a byte n under 0x80 is followed by n+1 bytes as they are, otherwise the
+// byte after it is repeated n-0x80+3 times
+
+#define SPRITE_RLE 0x01
+#define SPRITE_MASK 0x02
+
+typedef struct {
+    uint8_t width;
+    uint8_t pages;
+    uint8_t flags;
+    uint8_t frames;
+    uint16_t frame_ms; // how long each frame is shown for, if it is an animation
+    const uint8_t *data;
+    const uint32_t *offsets; // where each frame (then its mask, if it has one) starts in data, and the end
+} sprite_t;
+
+// draw a frame with its top left at x and page (8 pixel row), either of which can be off the display
+void sprite_draw(ssd1306_t *disp, const sprite_t *s, uint frame, int x, int page);
+
+#endif
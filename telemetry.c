@@ -0,0 +1,152 @@
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "telemetry.h"
+
+static uint16_t seq = 0;
+
+// CRC-16/CCITT-FALSE a nibble at a time, small enough table to not be worth putting in RAM
+static const uint16_t crc_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+};
+
+uint16_t telemetry_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xffff;
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc << 4) ^ crc_table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ crc_table[(crc >> 12) ^ (data[i] & 0x0f)];
+    }
+    return crc;
+}
+
+// returns the encoded length, out needs len + len/254 + 1 bytes
+static size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code_pos = 0;
+    size_t o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (in[i]) {
+            out[o++] = in[i];
+            code++;
+        }
+        if (!in[i] || code == 0xff) {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+    return o;
+}
+
+size_t telemetry_cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size) {
+    size_t o = 0;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (!code || i + code - 1 > len) {
+            return 0;
+        }
+        for (uint8_t j = 1; j < code; j++) {
+            if (o == out_size) {
+                return 0;
+            }
+            out[o++] = in[i++];
+        }
+        if (code != 0xff && i < len) {
+            if (o == out_size) {
+                return 0;
+            }
+            out[o++] = 0;
+        }
+    }
+    return o;
+}
+
+static uint8_t *put_le(uint8_t *p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        *p++ = v >> (8 * i);
+    }
+    return p;
+}
+
+// frame up a body and send it. putchar_raw because the stdio CR/LF translation would mangle it
+static void send(telemetry_type_t type, const uint8_t *body, size_t len) {
+    if (!SPEDO_TELEMETRY) {
+        return;
+    }
+    INSTR_STAMP(start);
+    uint8_t frame[TELEMETRY_MAX_FRAME];
+    uint8_t encoded[TELEMETRY_MAX_ENCODED];
+    frame[0] = type;
+    put_le(&frame[1], seq++, 2);
+    memcpy(&frame[3], body, len);
+    put_le(&frame[3 + len], telemetry_crc16(frame, 3 + len), 2);
+
+    encoded[0] = 0;
+    size_t n = 1 + cobs_encode(frame, 3 + len + 2, &encoded[1]);
+    encoded[n++] = 0;
+    for (size_t i = 0; i < n; i++) {
+        putchar_raw(encoded[i]);
+    }
+    INSTR_SINCE(INSTR_TELEMETRY, start);
+}
+
+void telemetry_edge(const reed_edge_t *edge) {
+    uint8_t body[TELEMETRY_TIME_BYTES + 2];
+    uint8_t *p = put_le(body, edge->time_us, TELEMETRY_TIME_BYTES);
+    *p++ = edge->closed;
+    *p = edge->channel;
+    send(TELEMETRY_EDGE, body, sizeof(body));
+}
+
+void telemetry_state(uint64_t time_us, int state) {
+    uint8_t body[TELEMETRY_TIME_BYTES + 1];
+    uint8_t *p = put_le(body, time_us, TELEMETRY_TIME_BYTES);
+    *p = state;
+    send(TELEMETRY_STATE, body, sizeof(body));
+}
+
+void telemetry_stats(uint64_t time_us, const telemetry_stats_t *stats) {
+    uint8_t body[TELEMETRY_STATS_BYTES];
+    uint8_t *p = put_le(body, time_us, TELEMETRY_TIME_BYTES);
+    p = put_le(p, stats->dist_mm, 4);
+    p = put_le(p, stats->all_time_s, 4);
+    p = put_le(p, stats->moving_time_s, 4);
+    p = put_le(p, stats->speed, 4);
+    p = put_le(p, stats->max_speed, 4);
+    p = put_le(p, stats->av_speed, 4);
+    p = put_le(p, (uint32_t)stats->accel, 4);
+    p = put_le(p, stats->revs, 4);
+    p = put_le(p, stats->dropped_edges, 2);
+    put_le(p, stats->cadence, 2);
+    send(TELEMETRY_STATS, body, sizeof(body));
+}
+
+void telemetry_histogram(uint64_t time_us, instr_hist_t h, const instr_histogram_t *hist) {
+    uint8_t body[TELEMETRY_HISTOGRAM_BYTES(INSTR_BUCKETS)];
+    uint8_t *p = put_le(body, time_us, TELEMETRY_TIME_BYTES);
+    *p++ = h;
+    p = put_le(p, hist->count, 4);
+    p = put_le(p, hist->count ? hist->total / hist->count : 0, 4);
+    p = put_le(p, hist->max, 4);
+    *p++ = INSTR_BUCKETS;
+    for (uint b = 0; b < INSTR_BUCKETS; b++) {
+        p = put_le(p, hist->buckets[b], 4);
+    }
+    send(TELEMETRY_HISTOGRAM, body, sizeof(body));
+}
+
+void telemetry_counters(uint64_t time_us, const uint32_t *counters, uint n) {
+    uint8_t body[TELEMETRY_COUNTERS_BYTES(INSTR_COUNTERS)];
+    if (n > INSTR_COUNTERS) {
+        n = INSTR_COUNTERS;
+    }
+    uint8_t *p = put_le(body, time_us, TELEMETRY_TIME_BYTES);
+    *p++ = n;
+    for (uint c = 0; c < n; c++) {
+        p = put_le(p, counters[c], 4);
+    }
+    send(TELEMETRY_COUNTERS, body, p - body);
+}
@@ -0,0 +1,70 @@
+#ifndef _inc_telemetry
+#define _inc_telemetry
+
+#include "pico/stdlib.h"
+#include "instr.h"
+#include "reed.h"
+#include "speed.h"
+
+// binary telemetry over stdio (USB serial), instead of a printf line per revolution.
+// set to 0 for the old human readable log
+#ifndef SPEDO_TELEMETRY
+#define SPEDO_TELEMETRY 1
+#endif
+
+// FRAMES
+//
+// each frame is COBS encoded and has a 0x00 byte either side, so a reader can always find the start of the
+// next one (and anything else printed in between can be told apart). decoded, a frame is:
+//   type (1 byte), sequence number (2), body, CRC-16/CCITT-FALSE of everything before it (2)
+// all little endian. the sequence number goes up by one every frame so lost frames can be counted.
+// times are the low 48 bits of time_us_64()
+
+typedef enum {
+    TELEMETRY_EDGE = 1,  // time (6), closed (1), channel (1) - every reed switch edge, as captured
+    TELEMETRY_STATE = 2, // time (6), state (1) - the mainloop changing state
+    TELEMETRY_STATS = 3, // time (6), then a telemetry_stats_t as 8 (u)int32_t and 2 uint16_t
+    TELEMETRY_HISTOGRAM = 4, // time (6), instr_hist_t (1), count (4), mean (4), max (4), buckets (1),
+                             // then each bucket's count (4) - see instr.h
+    TELEMETRY_COUNTERS = 5,  // time (6), counters (1), then each instr_counter_t's count (4)
+} telemetry_type_t;
+
+typedef struct {
+    uint32_t dist_mm;
+    uint32_t all_time_s;
+    uint32_t moving_time_s;
+    speed_q8_t speed;
+    speed_q8_t max_speed;
+    speed_q8_t av_speed;
+    int32_t accel;         // km/h per second (Q8)
+    uint32_t revs;
+    uint16_t dropped_edges;
+    uint16_t cadence;      // crank rpm
+} telemetry_stats_t;
+
+#define TELEMETRY_TIME_BYTES 6
+#define TELEMETRY_STATS_BYTES (TELEMETRY_TIME_BYTES + 8 * 4 + 2 * 2)
+#define TELEMETRY_HISTOGRAM_BYTES(buckets) (TELEMETRY_TIME_BYTES + 1 + 3 * 4 + 1 + (buckets) * 4)
+#define TELEMETRY_COUNTERS_BYTES(counters) (TELEMETRY_TIME_BYTES + 1 + (counters) * 4)
+
+// longest frame, decoded and encoded (COBS adds a byte every 254, and the delimiters)
+#define TELEMETRY_MAX_BODY (TELEMETRY_HISTOGRAM_BYTES(INSTR_BUCKETS) > TELEMETRY_STATS_BYTES ? \
+                            TELEMETRY_HISTOGRAM_BYTES(INSTR_BUCKETS) : TELEMETRY_STATS_BYTES)
+#define TELEMETRY_MAX_FRAME (1 + 2 + TELEMETRY_MAX_BODY + 2)
+#define TELEMETRY_MAX_ENCODED (TELEMETRY_MAX_FRAME + TELEMETRY_MAX_FRAME / 254 + 3)
+
+void telemetry_edge(const reed_edge_t *edge);
+void telemetry_state(uint64_t time_us, int state);
+void telemetry_stats(uint64_t time_us, const telemetry_stats_t *stats);
+void telemetry_histogram(uint64_t time_us, instr_hist_t h, const instr_histogram_t *hist);
+void telemetry_counters(uint64_t time_us, const uint32_t *counters, uint n);
+
+// READING ----------------------------------------------------------------------------
+
+uint16_t telemetry_crc16(const uint8_t *data, size_t len);
+
+// undo the COBS encoding of the bytes between two 0x00s. returns the decoded length,
+// or 0 if it isn't valid COBS or is longer than out_size
+size_t telemetry_cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size);
+
+#endif
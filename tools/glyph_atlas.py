@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+# pre-renders the OLED's text into glyph atlases at build time, see spedo_use_generated_headers in CMakeLists.txt
+#
+#   glyph_atlas.py <font.h> <glyph_atlas.h>
+#
+# the glyphs are stored the way the SSD1306 stores its pixels: a byte per column of 8 pixels (bit 0 at the
+# top), a page (8 rows) at a time, so drawing one at a page boundary is a memcpy per page rather than
+# decoding it bit by bit and scaling it every frame. there are three atlases:
+#   glyph_atlas_1x      font_8x5 as it is, every printable character
+#   glyph_atlas_2x      font_8x5 at twice the size, every printable character
+#   glyph_atlas_digits  big 0-9 for the speed, drawn here as 7 segment digits like the LED display
+# the flash each one takes is printed when it is generated (they are const, so they take no RAM)
+
+import re
+import sys
+
+FIRST = ord(' ')
+LAST = ord('~')
+
+# big digits: 14x24 (3 pages), segments 3 pixels thick with pointed ends
+DIGIT_WIDTH = 14
+DIGIT_HEIGHT = 24
+DIGIT_SEGS = [0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f]  # a-g in bits 0-6
+
+
+def read_font(path):
+    text = open(path).read()
+    body = text[text.index('{') + 1:text.index('}')]
+    body = re.sub(r'//[^\n]*', '', body)
+    values = [int(v, 0) for v in body.replace(',', ' ').split()]
+    height, width = values[0], values[1]
+    columns = values[2:]
+    glyphs = [columns[i:i + width] for i in range(0, len(columns), width)]
+    return height, width, glyphs
+
+
+def font_rows(column, height):
+    # the pixels of a font column, top first
+    return [(column >> y) & 1 for y in range(height)]
+
+
+def scaled_glyph(columns, height, scale):
+    # rows of pixels, each a list of 0/1 left to right
+    width = len(columns)
+    return [[font_rows(columns[x // scale], height)[y // scale] for x in range(width * scale)]
+            for y in range(height * scale)]
+
+
+def segment_pixel(seg, x, y):
+    mid = (DIGIT_HEIGHT - 1) // 2
+    left, right = 1, DIGIT_WIDTH - 2
+    top, bottom = 1, DIGIT_HEIGHT - 2
+    if seg in (0, 3, 6):  # a, d, g: horizontal
+        yc = top if seg == 0 else bottom if seg == 3 else mid
+        d = abs(y - yc)
+        return d <= 1 and left + 1 + d <= x <= right - 1 - d
+    # b, c, e, f: vertical
+    xc = right if seg in (1, 2) else left
+    y0, y1 = (top, mid) if seg in (1, 5) else (mid, bottom)
+    d = abs(x - xc)
+    return d <= 1 and y0 + 1 + d <= y <= y1 - 1 - d
+
+
+def digit_glyph(n):
+    return [[int(any(DIGIT_SEGS[n] >> seg & 1 and segment_pixel(seg, x, y) for seg in range(7)))
+             for x in range(DIGIT_WIDTH)] for y in range(DIGIT_HEIGHT)]
+
+
+def pages(rows):
+    # rows of pixels into page bytes: page 0's columns, then page 1's...
+    out = []
+    for page in range(0, len(rows), 8):
+        for x in range(len(rows[0])):
+            byte = 0
+            for bit in range(8):
+                if page + bit < len(rows) and rows[page + bit][x]:
+                    byte |= 1 << bit
+            out.append(byte)
+    return out
+
+
+def atlas(name, comment, first, glyphs, advance):
+    height = len(glyphs[0])
+    width = len(glyphs[0][0])
+    npages = (height + 7) // 8
+    data = []
+    lines = []
+    for i, g in enumerate(glyphs):
+        b = pages(g)
+        data += b
+        c = chr(first + i)
+        lines.append('    ' + ', '.join('0x%02x' % v for v in b) + ',  // ' + (repr(c) if c != '\\' else "'\\\\'"))
+    size = len(data)
+    print('glyph atlas %s: %d glyphs of %dx%d, %d bytes flash, 0 bytes RAM' % (name, len(glyphs), width, height, size))
+    return size, ('// %s\n' % comment +
+                  'static const uint8_t %s_data[%d] = {\n' % (name, size) + '\n'.join(lines) + '\n};\n' +
+                  'static const glyph_atlas_t %s = {%d, %d, %d, %d, %d, %s_data};\n' %
+                  (name, first, len(glyphs), width, npages, advance, name))
+
+
+def main():
+    font_path, out_path = sys.argv[1], sys.argv[2]
+    height, width, font = read_font(font_path)
+    font = font[:LAST - FIRST + 1]
+
+    parts = [
+        atlas('glyph_atlas_1x', 'font_8x5, a character every %d pixels like ssd1306_draw_string' % height,
+              FIRST, [scaled_glyph(g, height, 1) for g in font], height),
+        atlas('glyph_atlas_2x', 'font_8x5 twice the size, a character every %d pixels' % (height * 2),
+              FIRST, [scaled_glyph(g, height, 2) for g in font], height * 2),
+        atlas('glyph_atlas_digits', 'big 7 segment style digits for the speed',
+              ord('0'), [digit_glyph(n) for n in range(10)], DIGIT_WIDTH + 3),
+    ]
+    total = sum(size for size, _ in parts)
+    print('glyph atlases: %d bytes flash in total' % total)
+
+    with open(out_path, 'w') as f:
+        f.write('// generated by tools/glyph_atlas.py from %s, don\'t edit\n\n' % font_path.replace('\\', '/').split('/')[-1])
+        f.write('#ifndef _inc_glyph_atlas\n#define _inc_glyph_atlas\n\n#include <stdint.h>\n\n')
+        f.write('// glyph i (character first+i) is pages rows of width bytes, the top page first, each byte a column\n'
+                '// of 8 pixels with bit 0 at the top - the same as the SSD1306 buffer, so a row is one memcpy\n'
+                'typedef struct {\n'
+                '    uint8_t first; // first character\n'
+                '    uint8_t count; // how many characters from first\n'
+                '    uint8_t width; // columns in each glyph\n'
+                '    uint8_t pages; // 8 pixel rows in each glyph\n'
+                '    uint8_t advance; // pixels from one character to the next\n'
+                '    const uint8_t *data;\n'
+                '} glyph_atlas_t;\n\n')
+        f.write('\n'.join(p for _, p in parts))
+        f.write('\n#endif\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+# converts BMPs into sprites for the OLED at build time, see spedo_use_generated_headers in CMakeLists.txt
+#
+#   sprites.py <sprites.h> <image.bmp>[:frames=N][:ms=N][:rle] ...
+#
+# each image becomes a sprite_t called sprite_<file name> in the SSD1306's page format (see sprite.h), so it
+# is drawn a page byte at a time rather than pixel by pixel. an animation is its frames side by side in one
+# BMP (frames=N, each ms=N long). black is off, white (anything light) is lit and magenta (ff00ff) is
+# transparent, which gives the sprite a mask. heights are rounded up to whole pages, transparent.
+# rle run length encodes it, which is worth it for pictures with big blank areas. the size of each sprite
+# (and what rle saved) is printed as it is converted. uncompressed 1, 4, 8 and 24 bit BMPs are read
+
+import os
+import struct
+import sys
+
+TRANSPARENT = (255, 0, 255)
+
+
+def read_bmp(path):
+    # rows of pixels, top first, each None (transparent), 0 or 1
+    data = open(path, 'rb').read()
+    if data[:2] != b'BM':
+        sys.exit('%s: not a BMP' % path)
+    offset, = struct.unpack_from('<I', data, 10)
+    header_size, width, height, planes, bpp, compression = struct.unpack_from('<IiiHHI', data, 14)
+    if compression != 0 or bpp not in (1, 4, 8, 24):
+        sys.exit('%s: only uncompressed 1, 4, 8 and 24 bit BMPs are supported' % path)
+    palette = []
+    if bpp <= 8:
+        colours, = struct.unpack_from('<I', data, 46)
+        colours = colours or 1 << bpp
+        for i in range(colours):
+            b, g, r, _ = struct.unpack_from('<BBBB', data, 14 + header_size + 4 * i)
+            palette.append((r, g, b))
+    stride = (width * bpp + 31) // 32 * 4
+    rows = []
+    for y in range(abs(height)):
+        row_start = offset + (abs(height) - 1 - y if height > 0 else y) * stride
+        row = []
+        for x in range(width):
+            if bpp == 24:
+                b, g, r = data[row_start + 3 * x:row_start + 3 * x + 3]
+                rgb = (r, g, b)
+            else:
+                bit = x * bpp
+                index = (data[row_start + bit // 8] >> (8 - bpp - bit % 8)) & ((1 << bpp) - 1)
+                rgb = palette[index]
+            if rgb == TRANSPARENT:
+                row.append(None)
+            else:
+                row.append(1 if (rgb[0] * 3 + rgb[1] * 6 + rgb[2]) >= 128 * 10 else 0)
+        rows.append(row)
+    return rows
+
+
+def pages(rows, x0, width, want):
+    # page bytes of a frame: pixels (or, if want is None, the mask), a row of width bytes per page
+    height = len(rows)
+    out = []
+    for page in range(0, height, 8):
+        for x in range(x0, x0 + width):
+            byte = 0
+            for bit in range(8):
+                y = page + bit
+                p = rows[y][x] if y < height else None
+                if (p is not None) if want is None else p == 1:
+                    byte |= 1 << bit
+            out.append(byte)
+    return out
+
+
+def rle(data):
+    # a byte n under 0x80 is followed by n+1 bytes as they are, otherwise the next byte is repeated n-0x80+3 times
+    out = []
+    literal = []
+    i = 0
+
+    def flush():
+        while literal:
+            chunk = literal[:128]
+            del literal[:128]
+            out.append(len(chunk) - 1)
+            out.extend(chunk)
+
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and data[i + run] == data[i] and run < 130:
+            run += 1
+        if run >= 3:
+            flush()
+            out += [0x80 + run - 3, data[i]]
+            i += run
+        else:
+            literal.append(data[i])
+            i += 1
+    flush()
+    return out
+
+
+def convert(spec):
+    path, *options = spec.split(':')
+    frames, ms, compress = 1, 0, False
+    for option in options:
+        key, _, value = option.partition('=')
+        if key == 'frames':
+            frames = int(value)
+        elif key == 'ms':
+            ms = int(value)
+        elif key == 'rle':
+            compress = True
+        else:
+            sys.exit('%s: unknown option %s' % (path, option))
+    name = os.path.splitext(os.path.basename(path))[0]
+    rows = read_bmp(path)
+    if len(rows[0]) % frames:
+        sys.exit('%s: %d pixels wide, which isn\'t %d frames' % (path, len(rows[0]), frames))
+    width = len(rows[0]) // frames
+    npages = (len(rows) + 7) // 8
+    if width > 255 or npages > 8 or frames > 255:
+        sys.exit('%s: too big' % path)
+    masked = len(rows) % 8 != 0 or any(p is None for row in rows for p in row)
+
+    data = []
+    offsets = []
+    raw_size = 0
+    for f in range(frames):
+        for want in (1, None) if masked else (1,):
+            stream = pages(rows, f * width, width, want)
+            raw_size += len(stream)
+            offsets.append(len(data))
+            data += rle(stream) if compress else stream
+    offsets.append(len(data))
+
+    flags = (['SPRITE_RLE'] if compress else []) + (['SPRITE_MASK'] if masked else [])
+    size = len(data) + 4 * len(offsets)
+    print('sprite %s: %d frame%s of %dx%d%s, %d bytes flash%s' % (
+        name, frames, 's' if frames > 1 else '', width, npages * 8, ' with a mask' if masked else '', size,
+        ' (%d without rle)' % (raw_size + 4 * len(offsets)) if compress else ''))
+
+    lines = ['    ' + ', '.join('0x%02x' % v for v in data[i:i + 16]) + ',' for i in range(0, len(data), 16)]
+    return ('static const uint8_t sprite_%s_data[%d] = {\n' % (name, len(data)) + '\n'.join(lines) + '\n};\n' +
+            'static const uint32_t sprite_%s_offsets[%d] = {%s};\n' % (
+                name, len(offsets), ', '.join(str(o) for o in offsets)) +
+            'static const sprite_t sprite_%s = {%d, %d, %s, %d, %d, sprite_%s_data, sprite_%s_offsets};\n' % (
+                name, width, npages, ' | '.join(flags) or '0', frames, ms, name, name))
+
+
+def main():
+    out_path = sys.argv[1]
+    parts = [convert(spec) for spec in sys.argv[2:]]
+    with open(out_path, 'w') as f:
+        f.write('// generated by tools/sprites.py, don\'t edit\n\n')
+        f.write('#ifndef _inc_sprites\n#define _inc_sprites\n\n#include "sprite.h"\n\n')
+        f.write('\n'.join(parts))
+        f.write('\n#endif\n')
+
+
+if __name__ == '__main__':
+    main()